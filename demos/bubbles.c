@@ -32,6 +32,8 @@ struct {
     par_bubbles_t* bubbles;
     par_bubbles_t* culled;
     parg_buffer* centers;
+    parg_varray_layout* layout;
+    parg_renderqueue* queue;
     int hover;
     int potentially_clicking;
     double current_time;
@@ -99,6 +101,17 @@ void init(float winwidth, float winheight, float pixratio)
     // on every frame, growing it if necessary.  The starting size doesn't
     // matter much.
     app.centers = parg_buffer_alloc(512 * 4 * sizeof(float), PARG_GPU_ARRAY);
+
+    // Record the vertex streams once so that each frame binds them with a
+    // single call.
+    app.layout = parg_varray_layout_create();
+    parg_varray_layout_index(app.layout, parg_mesh_index(app.disk));
+    parg_varray_layout_enable(app.layout, parg_mesh_coord(app.disk),
+        A_POSITION, 3, PARG_FLOAT, 0, 0);
+    parg_varray_layout_instances(app.layout, A_CENTER, 1);
+    parg_varray_layout_enable(
+        app.layout, app.centers, A_CENTER, 4, PARG_FLOAT, 0, 0);
+    app.queue = parg_renderqueue_create();
 }
 
 void draw()
@@ -107,21 +120,6 @@ void draw()
     Point3 eyepos, eyepos_lowpart;
     parg_zcam_highprec(&mvp, &eyepos_lowpart, &eyepos);
     parg_draw_clear();
-    parg_shader_bind(P_SIMPLE);
-
-    // For the best possible precision, we bake the pan offset into the
-    // geometry, so there's no need to transform X and Y in the shader.
-    Point3 eyez = {0, 0, eyepos.z};
-    parg_uniform_point(U_EYEPOS, &eyez);
-    parg_uniform_point(U_EYEPOS_LOWPART, &eyepos_lowpart);
-
-    parg_uniform_matrix4f(U_MVP, &mvp);
-    parg_uniform1f(U_SEL, app.hover);
-    parg_varray_bind(parg_mesh_index(app.disk));
-    parg_varray_enable(
-        parg_mesh_coord(app.disk), A_POSITION, 3, PARG_FLOAT, 0, 0);
-    parg_varray_instances(A_CENTER, 1);
-    parg_varray_enable(app.centers, A_CENTER, 4, PARG_FLOAT, 0, 0);
     double aabb[4];
     parg_zcam_get_viewportd(aabb);
     double minradius = 4.0 * (aabb[2] - aabb[0]) / app.bbwidth;
@@ -139,8 +137,29 @@ void draw()
         fdisk[3] = app.culled->ids[i];
     }
     parg_buffer_unlock(app.centers);
-    parg_draw_instanced_triangles_u16(
-        0, parg_mesh_ntriangles(app.disk), app.culled->count);
+    if (!app.culled->count) {
+        return;
+    }
+
+    // For the best possible precision, we bake the pan offset into the
+    // geometry, so there's no need to transform X and Y in the shader.
+    Point3 eyez = {0, 0, eyepos.z};
+    float sel = app.hover;
+    parg_render_item item = {0};
+    item.program = P_SIMPLE;
+    item.layout = app.layout;
+    item.indextype = PARG_USHORT;
+    item.ntriangles = parg_mesh_ntriangles(app.disk);
+    item.ninstances = app.culled->count;
+    item.blending = 1;
+    item.cullfaces = 1;
+    parg_renderqueue_clear(app.queue);
+    parg_renderqueue_add(app.queue, &item);
+    parg_renderqueue_uniform(app.queue, U_EYEPOS, &eyez, 3);
+    parg_renderqueue_uniform(app.queue, U_EYEPOS_LOWPART, &eyepos_lowpart, 3);
+    parg_renderqueue_uniform(app.queue, U_MVP, &mvp, 16);
+    parg_renderqueue_uniform(app.queue, U_SEL, &sel, 1);
+    parg_renderqueue_submit(&app.queue, 1);
 }
 
 int tick(float winwidth, float winheight, float pixratio, float seconds)
@@ -165,6 +184,8 @@ int tick(float winwidth, float winheight, float pixratio, float seconds)
 void dispose()
 {
     parg_shader_free(P_SIMPLE);
+    parg_renderqueue_free(app.queue);
+    parg_varray_layout_free(app.layout);
     parg_mesh_free(app.disk);
     parg_buffer_free(app.centers);
     cleanup();
@@ -168,30 +168,21 @@ static void create_mesh()
 
     nmeshes = par_msquares_get_count(mlist);
     printf("%d meshes\n", nmeshes);
+    parg_mesh_builder* builder = parg_mesh_builder_create();
     for (int imesh = 0; imesh < nmeshes; imesh++) {
         par_msquares_mesh const* mesh = par_msquares_get_mesh(mlist, imesh);
 
-        // mquares_mesh might have dimensionality of 2 or 3, while parg_mesh
-        // only
-        // supports the latter.  So, we potentially need to expand the data from
-        // vec2 to vec3.
-
-        float* points = mesh->points;
-        if (mesh->dim == 2) {
-            points = malloc(mesh->npoints * sizeof(float) * 3);
-            for (int i = 0; i < mesh->npoints; i++) {
-                points[i * 3] = mesh->points[i * 2];
-                points[i * 3 + 1] = mesh->points[i * 2 + 1];
-                points[i * 3 + 2] = 0;
-            }
-        }
+        // msquares meshes might have a dimensionality of 2 or 3, while
+        // parg_mesh only supports the latter, so the builder widens them.
+        parg_mesh_builder_clear(builder);
+        int base = parg_mesh_builder_append_coords(
+            builder, mesh->points, mesh->npoints, mesh->dim);
+        parg_mesh_builder_append_triangles_u16(
+            builder, mesh->triangles, mesh->ntriangles, base);
         meshcolors[imesh] = mesh->color;
-        trimesh[imesh] = parg_mesh_create(
-            points, mesh->npoints, mesh->triangles, mesh->ntriangles);
-        if (mesh->dim == 2) {
-            free(points);
-        }
+        trimesh[imesh] = parg_mesh_builder_finalize(builder);
     }
+    parg_mesh_builder_free(builder);
 
     par_msquares_free(mlist);
 }
@@ -203,6 +194,7 @@ void init(float winwidth, float winheight, float pixratio)
     parg_state_cullfaces(1);
     parg_state_depthtest(1);
     parg_shader_load_from_asset(SHADER_SIMPLE);
+    parg_shader_prewarm(0);
 
     int* rawdata;
     colorbuf = parg_buffer_slurp_asset(TEXTURE_COLOR, (void*) &rawdata);
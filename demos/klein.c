@@ -1,5 +1,6 @@
 #include <parg.h>
 #include <parwin.h>
+#include <assert.h>
 #include <par/par_shapes.h>
 
 #define TOKEN_TABLE(F)              \
@@ -56,6 +57,9 @@ void init(float winwidth, float winheight, float pixratio)
     par_shapes_free_mesh(shape);
 
     kleingeo = parg_mesh_from_asset(M_KLEIN);
+
+    // The chart ranges below are drawn with 16-bit indices.
+    assert(parg_mesh_index_type(kleingeo) == PARG_USHORT);
     parg_mesh_send_to_gpu(kleingeo);
 
     kleintex = parg_texture_from_asset_linear(T_KLEIN);
@@ -336,7 +336,11 @@ void draw()
     parg_uniform_matrix3f(U_IMV, &invmodelview);
     parg_uniform_matrix4f(U_MVP, &mvp);
 
-    parg_draw_triangles_u16(0, parg_mesh_ntriangles(mesh));
+    if (parg_mesh_index_type(mesh) == PARG_UINT) {
+        parg_draw_triangles_u32(0, parg_mesh_ntriangles(mesh));
+    } else {
+        parg_draw_triangles_u16(0, parg_mesh_ntriangles(mesh));
+    }
     parg_varray_disable(A_NORMAL);
     parg_varray_disable(A_TEXCOORD);
 }
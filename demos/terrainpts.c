@@ -10,15 +10,12 @@
 
 #define DO_BAKE 0
 
-#define TOKEN_TABLE(F)                    \
-    F(P_SIMPLE, "p_simple")               \
-    F(P_TEXTURED, "p_textured")           \
-    F(A_POSITION, "a_position")           \
-    F(A_TEXCOORD, "a_texcoord")           \
-    F(U_MVP, "u_mvp")                     \
-    F(U_EYEPOS, "u_eyepos")               \
-    F(U_MAGNIFICATION, "u_magnification") \
-    F(U_DENSITY, "u_density")             \
+#define TOKEN_TABLE(F)            \
+    F(P_SIMPLE, "p_simple")       \
+    F(P_TEXTURED, "p_textured")   \
+    F(A_POSITION, "a_position")   \
+    F(A_TEXCOORD, "a_texcoord")   \
+    F(U_DENSITY, "u_density")     \
     F(U_POINTSIZE, "u_pointsize")
 
 TOKEN_TABLE(PARG_TOKEN_DECLARE);
@@ -109,16 +106,7 @@ void init(float winwidth, float winheight, float pixratio)
 
 void draw()
 {
-    Matrix4 view;
-    Matrix4 projection;
-    parg_zcam_matrices(&projection, &view);
-    Matrix4 model = M4MakeIdentity();
-
-    Point3 eyepos;
-    parg_zcam_highprec(0, 0, &eyepos);
-
-    Matrix4 modelview = M4Mul(view, model);
-    Matrix4 mvp = M4Mul(projection, modelview);
+    parg_uniformblock_zcam();
     parg_draw_clear();
     parg_texture_bind(terraintex, 0);
 
@@ -126,14 +114,9 @@ void draw()
     parg_varray_enable(
         parg_mesh_coord(backquad), A_POSITION, 2, PARG_FLOAT, 0, 0);
     parg_varray_enable(parg_mesh_uv(backquad), A_TEXCOORD, 2, PARG_FLOAT, 0, 0);
-    parg_uniform1f(U_MAGNIFICATION, parg_zcam_get_magnification());
-    parg_uniform_matrix4f(U_MVP, &mvp);
     parg_draw_one_quad();
 
     parg_shader_bind(P_SIMPLE);
-    parg_uniform_matrix4f(U_MVP, &mvp);
-    parg_uniform_point(U_EYEPOS, &eyepos);
-    parg_uniform1f(U_MAGNIFICATION, parg_zcam_get_magnification());
     parg_uniform1f(U_DENSITY, 0.1f);
     parg_uniform1f(U_POINTSIZE, 20.0f * pointscale);
     parg_varray_enable(ptsvbo, A_POSITION, 3, PARG_FLOAT, 0, 0);
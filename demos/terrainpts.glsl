@@ -2,10 +2,13 @@
 // @program p_simple, vertex, fragment
 // @program p_textured, vtexture, ftexture
 
-uniform mat4 u_mvp;
-uniform vec3 u_eyepos;
+@block b_camera
+mat4 u_mvp;
+vec3 u_eyepos;
+float u_magnification;
+@endblock
+
 uniform float u_pointsize;
-uniform float u_magnification;
 uniform float u_density;
 varying float v_pointsize;
 varying float v_alpha;
@@ -7,16 +7,14 @@
 #define PAR_MSQUARES_IMPLEMENTATION
 #include <par/par_msquares.h>
 
-#define TOKEN_TABLE(F)                              \
-    F(P_LANDMASS, "p_landmass")                     \
-    F(P_LANDMASS_FRAGCOORD, "p_landmass_fragcoord") \
-    F(P_OCEAN, "p_ocean")                           \
-    F(P_SOLID, "p_solid")                           \
-    F(A_POSITION, "a_position")                     \
-    F(U_MVP, "u_mvp")                               \
-    F(U_COLOR, "u_color")                           \
-    F(U_SHOWGRID, "u_showgrid")                     \
-    F(U_SLIPPYBOX, "u_slippybox")                   \
+#define TOKEN_TABLE(F)            \
+    F(P_LANDMASS, "p_landmass")   \
+    F(P_OCEAN, "p_ocean")         \
+    F(P_SOLID, "p_solid")         \
+    F(A_POSITION, "a_position")   \
+    F(U_MVP, "u_mvp")             \
+    F(U_COLOR, "u_color")         \
+    F(U_SLIPPYBOX, "u_slippybox") \
     F(U_SLIPPYFRACT, "u_slippyfract")
 TOKEN_TABLE(PARG_TOKEN_DECLARE);
 
@@ -27,6 +25,10 @@ TOKEN_TABLE(PARG_TOKEN_DECLARE);
     F(TEXTURE_OCEAN, "water.png")
 ASSET_TABLE(PARG_TOKEN_DECLARE);
 
+// Bits for the permutation flags declared by the @program lines.
+#define VARIANT_SHOWGRID 1
+#define VARIANT_FRAGCOORD 2
+
 const Vector3 TARGETPOS = {0.35287, 0.005156, 0.000005};
 const float DEMO_DURATION = 6;
 const double STARTZ = 1.2;
@@ -103,9 +105,9 @@ void draw()
     slippybox->w = 1.0 / (slippybox->w - slippybox->y);
 
     parg_draw_clear();
-    parg_shader_bind(P_OCEAN);
+    int gridmask = showgrid ? VARIANT_SHOWGRID : 0;
+    parg_shader_bind_variant(P_OCEAN, gridmask);
     parg_uniform_matrix4f(U_MVP, &mvp);
-    parg_uniform1i(U_SHOWGRID, showgrid);
     parg_uniform4f(U_SLIPPYBOX, slippybox);
     parg_uniform1f(U_SLIPPYFRACT, slippyfract);
     parg_texture_bind(ocean_texture, 0);
@@ -130,9 +132,9 @@ void draw()
         slippybox->y = (slippybox->y - rect.bottom) / y;
     }
 
-    parg_shader_bind(mode_highp ? P_LANDMASS_FRAGCOORD : P_LANDMASS);
+    parg_shader_bind_variant(
+        P_LANDMASS, gridmask | (mode_highp ? VARIANT_FRAGCOORD : 0));
     parg_uniform_matrix4f(U_MVP, &mvp);
-    parg_uniform1i(U_SHOWGRID, showgrid);
     parg_uniform4f(U_SLIPPYBOX, slippybox);
     parg_uniform1f(U_SLIPPYFRACT, slippyfract);
     parg_texture_bind(paper_texture, 0);
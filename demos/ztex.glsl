@@ -1,14 +1,12 @@
 
-// @program p_landmass, vertex, landmass
-// @program p_landmass_fragcoord, vertex, landmass_fragcoord
-// @program p_ocean, vertex, ocean
+// @program p_landmass, vertex, landmass [SHOWGRID, FRAGCOORD]
+// @program p_ocean, vertex, ocean [SHOWGRID]
 // @program p_solid, vertex, solid
 
 uniform mat4 u_mvp;
 uniform vec4 u_color;
 uniform vec4 u_slippybox;
 uniform float u_slippyfract;
-uniform bool u_showgrid;
 uniform sampler2D u_texture;
 varying vec2 v_texcoord;
 
@@ -19,12 +17,12 @@ const vec4 LANDMASS_COLOR = vec4(0.5, 0.7, 0.6, 1.0);
 vec4 sample(vec2 uv)
 {
     vec4 texel = texture2D(u_texture, uv);
-    if (u_showgrid) {
-        uv = mod(uv, vec2(1));
-        vec2 del = abs(vec2(0.5) - uv);
-        vec2 m = 0.5 * smoothstep(0.5, 0.45, del);
-        texel *= m.x * m.y + 0.5;
-    }
+#ifdef SHOWGRID
+    uv = mod(uv, vec2(1));
+    vec2 del = abs(vec2(0.5) - uv);
+    vec2 m = 0.5 * smoothstep(0.5, 0.45, del);
+    texel *= m.x * m.y + 0.5;
+#endif
     return texel;
 }
 
@@ -58,19 +56,11 @@ void main()
 
 void main()
 {
-    vec2 tex_offset = v_texcoord - u_slippybox.xy;
-    vec2 uv = tex_offset * u_slippybox.zw;
-    vec4 texel0 = sample(uv * LANDMASS_TEXTURE_FREQUENCY);
-    vec4 texel1 = sample(uv * LANDMASS_TEXTURE_FREQUENCY * 2.0);
-    vec4 mixed = mix(texel0, texel1, u_slippyfract);
-    gl_FragColor = LANDMASS_COLOR * mixed;
-}
-
--- landmass_fragcoord
-
-void main()
-{
+#ifdef FRAGCOORD
     vec2 tex_offset = gl_FragCoord.xy - u_slippybox.xy;
+#else
+    vec2 tex_offset = v_texcoord - u_slippybox.xy;
+#endif
     vec2 uv = tex_offset * u_slippybox.zw;
     vec4 texel0 = sample(uv * LANDMASS_TEXTURE_FREQUENCY);
     vec4 texel1 = sample(uv * LANDMASS_TEXTURE_FREQUENCY * 2.0);
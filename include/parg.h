@@ -33,6 +33,7 @@ extern "C" {
 #define PARG_UINT 0x1405
 #define PARG_FLOAT 0x1406
 #define PARG_DOUBLE 0x140A
+#define PARG_HALF 0x140B
 
 #define PARG_FBO_FLOAT (1 << 0)
 #define PARG_FBO_ALPHA (1 << 1)
@@ -40,6 +41,28 @@ extern "C" {
 #define PARG_FBO_LINEAR (1 << 3)
 #define PARG_FBO_DEPTH (1 << 3)
 
+#define PARG_OPTIMIZE_VCACHE (1 << 0)
+#define PARG_OPTIMIZE_OVERDRAW (1 << 1)
+#define PARG_OPTIMIZE_VFETCH (1 << 2)
+#define PARG_OPTIMIZE_ALL 7
+
+#define PARG_QUANTIZE_POSITION (1 << 0)
+#define PARG_QUANTIZE_NORMAL8 (1 << 1)
+#define PARG_QUANTIZE_NORMAL16 (1 << 2)
+#define PARG_QUANTIZE_UV_HALF (1 << 3)
+#define PARG_QUANTIZE_UV16 (1 << 4)
+
+#define PARG_PMESH_LZ4 (1 << 0)
+
+#define PARG_WEIGHT_AREA 0
+#define PARG_WEIGHT_ANGLE 1
+
+#define PARG_WELD_POSITION 0
+#define PARG_WELD_UV (1 << 0)
+#define PARG_WELD_NORMAL (1 << 1)
+#define PARG_WELD_TANGENT (1 << 2)
+#define PARG_WELD_ALL 7
+
 typedef unsigned int parg_data_type;
 typedef unsigned char parg_byte;
 
@@ -55,10 +78,34 @@ typedef enum { PARG_READ, PARG_WRITE, PARG_MODIFY } parg_buffer_mode;
 // TOKENS
 
 typedef uint32_t parg_token;
-#define PARG_TOKEN_DECLARE(NAME, VAL) static parg_token NAME;
-#define PARG_TOKEN_DEFINE(NAME, VAL) NAME = parg_token_from_string(VAL);
+
+// Tokens for string literals are hashed at compile time with the same X31
+// hash that parg_token_from_string uses at run time.  PARG_TOKEN_DEFINE only
+// records the literal so that the token can be converted back to a string.
+#define PARG_TOKEN_MAXLEN 64
+#define PARG_TOKEN_DECLARE(NAME, VAL)                       \
+    static const parg_token NAME = PARG_TOKEN_HASH(VAL);    \
+    typedef char NAME##_token_length_check[                 \
+        sizeof(VAL) <= PARG_TOKEN_MAXLEN + 1 ? 1 : -1];
+#define PARG_TOKEN_DEFINE(NAME, VAL) parg_token_intern(NAME, VAL);
+#define PARG_TOKEN_STEP_(S, I, H)                             \
+    ((H) * ((I) < sizeof(S) - 1 ? 31u : 1u) +                 \
+        ((I) < sizeof(S) - 1                                  \
+                ? (parg_token) S[(I) < sizeof(S) - 1 ? (I) : 0] \
+                : 0u))
+#define PARG_TOKEN_HASH8_(S, I, H)                                   \
+    PARG_TOKEN_STEP_(S, I + 7, PARG_TOKEN_STEP_(S, I + 6,            \
+        PARG_TOKEN_STEP_(S, I + 5, PARG_TOKEN_STEP_(S, I + 4,        \
+        PARG_TOKEN_STEP_(S, I + 3, PARG_TOKEN_STEP_(S, I + 2,        \
+        PARG_TOKEN_STEP_(S, I + 1, PARG_TOKEN_STEP_(S, I, H))))))))
+#define PARG_TOKEN_HASH(S)                                           \
+    PARG_TOKEN_HASH8_(S, 56, PARG_TOKEN_HASH8_(S, 48,                \
+        PARG_TOKEN_HASH8_(S, 40, PARG_TOKEN_HASH8_(S, 32,            \
+        PARG_TOKEN_HASH8_(S, 24, PARG_TOKEN_HASH8_(S, 16,            \
+        PARG_TOKEN_HASH8_(S, 8, PARG_TOKEN_HASH8_(S, 0, 0u))))))))
 const char* parg_token_to_string(parg_token);
 parg_token parg_token_from_string(const char*);
+void parg_token_intern(parg_token token, const char* literal);
 
 // ASSETS
 
@@ -118,29 +165,105 @@ float parg_aar_centery(parg_aar rect);
 typedef struct parg_mesh_s parg_mesh;
 struct par_shapes_mesh_s;
 
+typedef struct {
+    float position;
+    float normal;
+    float uv;
+} parg_quantize_error;
+
+typedef struct {
+    Point3 lower;
+    Point3 upper;
+    Point3 center;
+    float radius;
+} parg_mesh_bounds;
+
+typedef struct {
+    float distance;
+    int triangle;
+    float u, v;
+    Point3 position;
+} parg_mesh_hit;
+
 parg_mesh* parg_mesh_create(float* pts, int npts, uint16_t* tris, int ntris);
+parg_mesh* parg_mesh_create_u32(
+    float* pts, int npts, uint32_t* tris, int ntris);
 parg_mesh* parg_mesh_from_shape(struct par_shapes_mesh_s const* src);
 parg_mesh* parg_mesh_from_asset(parg_token id);
 parg_mesh* parg_mesh_from_file(const char* filepath);
+void parg_mesh_to_file(parg_mesh* m, const char* filepath, int flags);
 parg_mesh* parg_mesh_knot(int cols, int rows, float major, float minor);
 parg_mesh* parg_mesh_torus(int cols, int rows, float major, float minor);
 parg_mesh* parg_mesh_rectangle(float width, float height);
 parg_mesh* parg_mesh_aar(parg_aar rect);
 parg_mesh* parg_mesh_sierpinski(float width, int depth);
+parg_mesh* parg_mesh_sierpinski_indexed(float width, int depth);
 void parg_mesh_free(parg_mesh* m);
 parg_buffer* parg_mesh_coord(parg_mesh* m);
 parg_buffer* parg_mesh_uv(parg_mesh* m);
 parg_buffer* parg_mesh_norml(parg_mesh* m);
+parg_buffer* parg_mesh_tangent(parg_mesh* m);
 parg_buffer* parg_mesh_index(parg_mesh* m);
 int parg_mesh_ntriangles(parg_mesh* m);
+parg_data_type parg_mesh_index_type(parg_mesh* m);
+int parg_mesh_nsubmeshes(parg_mesh* m);
+int parg_mesh_submesh_find(parg_mesh* m, parg_token name);
+parg_token parg_mesh_submesh_name(parg_mesh* m, int index);
+void parg_mesh_submesh_range(parg_mesh* m, int index, int* start, int* ntris);
+void parg_mesh_submesh_bounds(
+    parg_mesh* m, int index, Point3* lower, Point3* upper);
+void parg_mesh_compute_bounds(parg_mesh* m, parg_mesh_bounds* bounds);
+void parg_mesh_build_bvh(parg_mesh* m);
+int parg_mesh_raycast(
+    parg_mesh* m, Point3 origin, Vector3 dir, parg_mesh_hit* hit);
+parg_mesh** parg_mesh_split_u16(parg_mesh* m, int* nmeshes);
+void parg_mesh_optimize(parg_mesh* m, int flags);
+float parg_mesh_acmr(parg_mesh* m);
 void parg_mesh_compute_normals(parg_mesh* m);
+void parg_mesh_compute_normals_weighted(parg_mesh* m, int weighting);
+float parg_mesh_weld(parg_mesh* m, float epsilon, int attribute_mask);
+int parg_mesh_build_meshlets(parg_mesh* m, int max_verts, int max_tris);
+int parg_mesh_nmeshlets(parg_mesh* m);
+void parg_mesh_meshlet_range(parg_mesh* m, int index, int* start, int* ntris);
+int parg_mesh_cull_meshlets(
+    parg_mesh* m, Matrix4 viewproj, Point3 eyepos, int* visible);
 void parg_mesh_send_to_gpu(parg_mesh* m);
+void parg_mesh_interleave(parg_mesh* m);
+parg_buffer* parg_mesh_vertices(parg_mesh* m);
+int parg_mesh_stride(parg_mesh* m);
+void parg_mesh_quantize(parg_mesh* m, int flags, parg_quantize_error* err);
+Matrix4 parg_mesh_dequantize_matrix(parg_mesh* m);
+float parg_mesh_simplify(parg_mesh* m, float target_ratio, float max_error);
+int parg_mesh_lod_chain(parg_mesh* m, int maxlevels, float ratio);
+int parg_mesh_lod_select(parg_mesh* m, float screen_size, float pixel_error);
+void parg_mesh_lod_range(parg_mesh* m, int level, int* start, int* ntris);
+
+typedef struct parg_mesh_builder_s parg_mesh_builder;
+
+parg_mesh_builder* parg_mesh_builder_create();
+void parg_mesh_builder_free(parg_mesh_builder* b);
+void parg_mesh_builder_clear(parg_mesh_builder* b);
+int parg_mesh_builder_append_coords(
+    parg_mesh_builder* b, float const* src, int nverts, int ncomps);
+void parg_mesh_builder_append_uvs(
+    parg_mesh_builder* b, float const* src, int nverts);
+void parg_mesh_builder_append_normals(
+    parg_mesh_builder* b, float const* src, int nverts);
+void parg_mesh_builder_append_triangles_u16(
+    parg_mesh_builder* b, uint16_t const* src, int ntris, int basevertex);
+void parg_mesh_builder_append_triangles_u32(
+    parg_mesh_builder* b, uint32_t const* src, int ntris, int basevertex);
+parg_mesh* parg_mesh_builder_finalize(parg_mesh_builder* b);
+void parg_mesh_builder_rebuild(parg_mesh_builder* b, parg_mesh* m);
 
 // SHADERS
 
 void parg_shader_load_from_buffer(parg_buffer*);
 void parg_shader_load_from_asset(parg_token id);
 void parg_shader_bind(parg_token);
+void parg_shader_bind_variant(parg_token, uint32_t mask);
+void parg_shader_prewarm(parg_token);
+int parg_shader_prewarm_poll();
 void parg_shader_free(parg_token);
 
 // TEXTURES
@@ -168,6 +291,14 @@ void parg_uniform4f(parg_token, const Vector4* val);
 void parg_uniform_point(parg_token, const Point3* val);
 void parg_uniform_matrix4f(parg_token, const Matrix4* val);
 void parg_uniform_matrix3f(parg_token, const Matrix3* val);
+void parg_uniform_counters(int* issued, int* skipped);
+void parg_uniform_reset_counters();
+
+// UNIFORM BLOCKS
+
+void parg_uniformblock_set(parg_token member, void const* value);
+void parg_uniformblock_zcam();
+int parg_uniformblock_native();
 
 // GL STATE MACHINE
 
@@ -175,6 +306,10 @@ void parg_state_clearcolor(Vector4 color);
 void parg_state_cullfaces(int enabled);
 void parg_state_depthtest(int enabled);
 void parg_state_blending(int enabled);
+void parg_state_invalidate();
+void parg_state_validate(int enabled);
+void parg_state_counters(int* issued, int* filtered);
+void parg_state_reset_counters();
 
 // VERTEX ARRAYS
 
@@ -183,6 +318,21 @@ void parg_varray_bind(parg_buffer*);
 void parg_varray_enable(parg_buffer*, parg_token attr, int ncomps,
     parg_data_type type, int stride, int offset);
 void parg_varray_instances(parg_token attr, int divisor);
+void parg_varray_enable_mesh(parg_mesh*, parg_token coord, parg_token uv,
+    parg_token normal, parg_token tangent);
+
+typedef struct parg_varray_layout_s parg_varray_layout;
+
+parg_varray_layout* parg_varray_layout_create();
+void parg_varray_layout_free(parg_varray_layout*);
+void parg_varray_layout_enable(parg_varray_layout*, parg_buffer*,
+    parg_token attr, int ncomps, parg_data_type type, int stride, int offset);
+void parg_varray_layout_instances(
+    parg_varray_layout*, parg_token attr, int divisor);
+void parg_varray_layout_index(parg_varray_layout*, parg_buffer*);
+void parg_varray_layout_bind(parg_varray_layout*);
+parg_varray_layout* parg_varray_mesh_layout(parg_mesh*, parg_token coord,
+    parg_token uv, parg_token normal, parg_token tangent);
 
 // DRAW CALLS
 
@@ -192,14 +342,52 @@ void parg_draw_triangles(int start, int ntriangles);
 void parg_draw_triangles_u16(int start, int ntriangles);
 void parg_draw_wireframe_triangles_u16(int start, int ntriangles);
 void parg_draw_instanced_triangles_u16(int start, int ntris, int ninstances);
+void parg_draw_triangles_u32(int start, int ntriangles);
+void parg_draw_wireframe_triangles_u32(int start, int ntriangles);
+void parg_draw_submesh(parg_mesh* m, int index);
+void parg_draw_submeshes(parg_mesh* m, int const* indices, int count);
+void parg_draw_meshlets(parg_mesh* m, int const* indices, int count);
+void parg_draw_instanced_triangles_u32(int start, int ntris, int ninstances);
 void parg_draw_lines(int nsegments);
 void parg_draw_points(int npoints);
 
+// RENDER QUEUE
+
+#define PARG_RENDER_TEXTURES 4
+
+typedef struct parg_renderqueue_s parg_renderqueue;
+
+typedef struct {
+    int pass;
+    parg_token program;
+    uint32_t variant;
+    parg_texture* textures[PARG_RENDER_TEXTURES];
+    parg_varray_layout* layout;
+    parg_data_type indextype;
+    int start;
+    int ntriangles;
+    int ninstances;
+    float depth;
+    int blending;
+    int depthtest;
+    int cullfaces;
+} parg_render_item;
+
+parg_renderqueue* parg_renderqueue_create();
+void parg_renderqueue_free(parg_renderqueue*);
+void parg_renderqueue_clear(parg_renderqueue*);
+void parg_renderqueue_add(parg_renderqueue*, parg_render_item const*);
+void parg_renderqueue_uniform(
+    parg_renderqueue*, parg_token, void const* value, int nfloats);
+void parg_renderqueue_uniform1i(parg_renderqueue*, parg_token, int value);
+void parg_renderqueue_submit(parg_renderqueue** queues, int nqueues);
+
 // MAP CAMERA
 
 void parg_zcam_init(float world_width, float world_height, float fovy);
 void parg_zcam_tick(float window_aspect, float seconds);
 DPoint3 parg_zcam_to_world(float winx, float winy);
+void parg_zcam_to_ray(float winx, float winy, Point3* origin, Vector3* dir);
 float parg_zcam_get_magnification();
 void parg_zcam_get_viewport(float* lbrt);
 void parg_zcam_get_viewportd(double* lbrt);
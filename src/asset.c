@@ -34,7 +34,7 @@ void parg_asset_preload(parg_token id)
     if (!_pngsuffix) {
         _pngsuffix = sdsnew(".png");
     }
-    sds filename = parg_token_to_sds(id);
+    sds filename = sdsnew(parg_token_to_string(id));
     parg_buffer* buf = parg_buffer_from_path(filename);
     parg_assert(buf, "Unable to load asset");
     if (sdslen(filename) > 4) {
@@ -60,6 +60,7 @@ void parg_asset_preload(parg_token id)
         }
         sdsfree(suffix);
     }
+    sdsfree(filename);
     if (!_asset_registry) {
         _asset_registry = kh_init(assmap);
     }
@@ -58,6 +58,15 @@ void pargDrawElementsInstanced(GLenum a, GLsizei b, GLenum c, const void * d,
         "drawElementsInstancedANGLE", a, b, c, (int) d, (int) e);
 }
 
+// WebGL 1.0 has no multi-draw, so this simply issues one call per range.
+void pargMultiDrawElements(GLenum a, const GLsizei* b, GLenum c,
+    const void* const* d, GLsizei e)
+{
+    for (GLsizei i = 0; i < e; i++) {
+        glDrawElements(a, b[i], c, d[i]);
+    }
+}
+
 void parg_window_setargs(int argc, char* argv[])
 {
     _argc = argc;
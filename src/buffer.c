@@ -10,8 +10,25 @@ struct parg_buffer_s {
     parg_buffer_type memtype;
     GLuint gpuhandle;
     char* gpumapped;
+    uint32_t serial;
 };
 
+// Serials identify buffers for the mesh layout cache, since addresses and GL
+// names are both recycled.
+static uint32_t _next_serial = 1;
+
+uint32_t parg_buffer_serial(parg_buffer* buf) { return buf->serial; }
+
+// Element buffer bindings are part of the vertex array state, so uploads must
+// not disturb a bound layout.
+static void bind_for_upload(GLenum target, GLuint handle)
+{
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        parg_varray_unbind_layout();
+    }
+    parg_state_bind_buffer(target, handle);
+}
+
 parg_buffer* parg_buffer_create(void* src, int nbytes, parg_buffer_type memtype)
 {
     parg_buffer* retval = malloc(sizeof(struct parg_buffer_s));
@@ -19,11 +36,12 @@ parg_buffer* parg_buffer_create(void* src, int nbytes, parg_buffer_type memtype)
     retval->memtype = memtype;
     retval->gpuhandle = 0;
     retval->gpumapped = 0;
+    retval->serial = _next_serial++;
     if (parg_buffer_gpu_check(retval)) {
         glGenBuffers(1, &retval->gpuhandle);
         GLenum target = memtype == PARG_GPU_ARRAY ? GL_ARRAY_BUFFER
             : GL_ELEMENT_ARRAY_BUFFER;
-        glBindBuffer(target, retval->gpuhandle);
+        bind_for_upload(target, retval->gpuhandle);
         glBufferData(target, nbytes, src, GL_STATIC_DRAW);
     } else {
         retval->data = malloc(nbytes);
@@ -47,6 +65,7 @@ parg_buffer* parg_buffer_alloc(int nbytes, parg_buffer_type memtype)
     retval->memtype = memtype;
     retval->gpuhandle = 0;
     retval->gpumapped = 0;
+    retval->serial = _next_serial++;
     if (parg_buffer_gpu_check(retval)) {
         glGenBuffers(1, &retval->gpuhandle);
     }
@@ -71,6 +90,7 @@ void parg_buffer_free(parg_buffer* buf)
         return;
     }
     if (parg_buffer_gpu_check(buf)) {
+        parg_state_forget_buffer(buf->gpuhandle);
         glDeleteBuffers(1, &buf->gpuhandle);
     } else {
         free(buf->data);
@@ -109,13 +129,30 @@ void parg_buffer_unlock(parg_buffer* buf)
         GLenum target = buf->memtype == PARG_GPU_ARRAY
             ? GL_ARRAY_BUFFER
             : GL_ELEMENT_ARRAY_BUFFER;
-        glBindBuffer(target, buf->gpuhandle);
+        bind_for_upload(target, buf->gpuhandle);
         glBufferData(target, buf->nbytes, buf->gpumapped, GL_STATIC_DRAW);
         free(buf->gpumapped);
         buf->gpumapped = 0;
     }
 }
 
+// Replaces the entire contents of the buffer, possibly changing its size,
+// without creating a new GPU object.
+void parg_buffer_respecify(parg_buffer* buf, void const* src, int nbytes)
+{
+    buf->nbytes = nbytes;
+    if (parg_buffer_gpu_check(buf)) {
+        GLenum target = buf->memtype == PARG_GPU_ARRAY
+            ? GL_ARRAY_BUFFER
+            : GL_ELEMENT_ARRAY_BUFFER;
+        bind_for_upload(target, buf->gpuhandle);
+        glBufferData(target, nbytes, src, GL_DYNAMIC_DRAW);
+        return;
+    }
+    buf->data = realloc(buf->data, nbytes);
+    memcpy(buf->data, src, nbytes);
+}
+
 parg_buffer* parg_buffer_from_file(const char* filepath)
 {
     FILE* f = fopen(filepath, "rb");
@@ -179,5 +216,5 @@ void parg_buffer_gpu_bind(parg_buffer* buf)
     parg_assert(parg_buffer_gpu_check(buf), "GPU buffer required");
     GLenum target = buf->memtype == PARG_GPU_ARRAY ? GL_ARRAY_BUFFER
         : GL_ELEMENT_ARRAY_BUFFER;
-    glBindBuffer(target, parg_buffer_gpu_handle(buf));
+    parg_state_bind_buffer(target, parg_buffer_gpu_handle(buf));
 }
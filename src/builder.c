@@ -0,0 +1,210 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+
+// The builder accumulates vertex streams and 32-bit triangles in arrays that
+// grow geometrically and are never shrunk, so clearing and refilling it each
+// frame does not allocate once it reaches its peak size.  Each stream becomes
+// one GPU buffer, uploaded with a single call.  Indices are narrowed to 16
+// bits when the vertex count allows.
+
+typedef struct {
+    float* data;
+    int count;
+    int capacity;
+} builder_stream;
+
+struct parg_mesh_builder_s {
+    builder_stream coords;
+    builder_stream uvs;
+    builder_stream normals;
+    uint32_t* indices;
+    int ntriangles;
+    int tricapacity;
+    uint16_t* narrowed;
+    int narrowcapacity;
+};
+
+static void* reserve(void* data, int* capacity, int needed, int elemsize)
+{
+    if (needed <= *capacity) {
+        return data;
+    }
+    *capacity = PARG_MAX(needed, PARG_MAX(*capacity * 2, 64));
+    return realloc(data, (size_t) *capacity * elemsize);
+}
+
+static float* append_stream(builder_stream* stream, int count, int ncomps)
+{
+    stream->data = reserve(stream->data, &stream->capacity,
+        stream->count + count, sizeof(float) * ncomps);
+    float* dst = stream->data + stream->count * ncomps;
+    stream->count += count;
+    return dst;
+}
+
+parg_mesh_builder* parg_mesh_builder_create()
+{
+    return calloc(1, sizeof(struct parg_mesh_builder_s));
+}
+
+void parg_mesh_builder_free(parg_mesh_builder* builder)
+{
+    if (!builder) {
+        return;
+    }
+    free(builder->coords.data);
+    free(builder->uvs.data);
+    free(builder->normals.data);
+    free(builder->indices);
+    free(builder->narrowed);
+    free(builder);
+}
+
+void parg_mesh_builder_clear(parg_mesh_builder* builder)
+{
+    builder->coords.count = 0;
+    builder->uvs.count = 0;
+    builder->normals.count = 0;
+    builder->ntriangles = 0;
+}
+
+// Returns the index of the first appended vertex, which is typically passed
+// as the base vertex when appending the corresponding triangles.
+int parg_mesh_builder_append_coords(
+    parg_mesh_builder* builder, float const* src, int nverts, int ncomps)
+{
+    parg_assert(ncomps == 2 || ncomps == 3, "Coords must have 2 or 3 comps");
+    int base = builder->coords.count;
+    float* dst = append_stream(&builder->coords, nverts, 3);
+    if (ncomps == 3) {
+        memcpy(dst, src, sizeof(float) * 3 * nverts);
+        return base;
+    }
+    for (int i = 0; i < nverts; i++, src += 2) {
+        *dst++ = src[0];
+        *dst++ = src[1];
+        *dst++ = 0;
+    }
+    return base;
+}
+
+void parg_mesh_builder_append_uvs(
+    parg_mesh_builder* builder, float const* src, int nverts)
+{
+    float* dst = append_stream(&builder->uvs, nverts, 2);
+    memcpy(dst, src, sizeof(float) * 2 * nverts);
+}
+
+void parg_mesh_builder_append_normals(
+    parg_mesh_builder* builder, float const* src, int nverts)
+{
+    float* dst = append_stream(&builder->normals, nverts, 3);
+    memcpy(dst, src, sizeof(float) * 3 * nverts);
+}
+
+static uint32_t* append_triangles(parg_mesh_builder* builder, int ntris)
+{
+    builder->indices = reserve(builder->indices, &builder->tricapacity,
+        builder->ntriangles + ntris, sizeof(uint32_t) * 3);
+    uint32_t* dst = builder->indices + builder->ntriangles * 3;
+    builder->ntriangles += ntris;
+    return dst;
+}
+
+void parg_mesh_builder_append_triangles_u16(parg_mesh_builder* builder,
+    uint16_t const* src, int ntris, int basevertex)
+{
+    uint32_t* dst = append_triangles(builder, ntris);
+    for (int i = 0; i < ntris * 3; i++) {
+        dst[i] = src[i] + basevertex;
+    }
+}
+
+void parg_mesh_builder_append_triangles_u32(parg_mesh_builder* builder,
+    uint32_t const* src, int ntris, int basevertex)
+{
+    uint32_t* dst = append_triangles(builder, ntris);
+    for (int i = 0; i < ntris * 3; i++) {
+        dst[i] = src[i] + basevertex;
+    }
+}
+
+static void const* index_data(
+    parg_mesh_builder* builder, parg_data_type* type, int* nbytes)
+{
+    int nindices = builder->ntriangles * 3;
+    if (builder->coords.count > 0x10000) {
+        *type = PARG_UINT;
+        *nbytes = nindices * sizeof(uint32_t);
+        return builder->indices;
+    }
+    builder->narrowed = reserve(builder->narrowed, &builder->narrowcapacity,
+        nindices, sizeof(uint16_t));
+    for (int i = 0; i < nindices; i++) {
+        builder->narrowed[i] = builder->indices[i];
+    }
+    *type = PARG_USHORT;
+    *nbytes = nindices * sizeof(uint16_t);
+    return builder->narrowed;
+}
+
+static void check_streams(parg_mesh_builder* builder)
+{
+    int nverts = builder->coords.count;
+    parg_assert(!builder->uvs.count || builder->uvs.count == nverts,
+        "UV count must match coord count");
+    parg_assert(!builder->normals.count || builder->normals.count == nverts,
+        "Normal count must match coord count");
+}
+
+// Uploads the stream into the existing buffer if there is one, otherwise
+// creates one.  Empty streams release the buffer.
+static parg_buffer* upload_stream(
+    parg_buffer* buf, builder_stream const* stream, int ncomps)
+{
+    if (!stream->count) {
+        parg_buffer_free(buf);
+        return 0;
+    }
+    int nbytes = stream->count * ncomps * sizeof(float);
+    if (!buf) {
+        return parg_buffer_create(stream->data, nbytes, PARG_GPU_ARRAY);
+    }
+    parg_buffer_respecify(buf, stream->data, nbytes);
+    return buf;
+}
+
+parg_mesh* parg_mesh_builder_finalize(parg_mesh_builder* builder)
+{
+    parg_mesh* mesh = parg_mesh_alloc(3);
+    parg_mesh_builder_rebuild(builder, mesh);
+    return mesh;
+}
+
+// Replaces the contents of a mesh previously produced by the builder,
+// reusing its GPU buffers.
+void parg_mesh_builder_rebuild(parg_mesh_builder* builder, parg_mesh* mesh)
+{
+    check_streams(builder);
+    parg_assert(!mesh->vertices, "Interleaved meshes cannot be rebuilt");
+    mesh->coords = upload_stream(mesh->coords, &builder->coords, 3);
+    mesh->uvs = upload_stream(mesh->uvs, &builder->uvs, 2);
+    mesh->normals = upload_stream(mesh->normals, &builder->normals, 3);
+    parg_buffer_free(mesh->tangents);
+    mesh->tangents = 0;
+
+    int nbytes;
+    void const* indices = index_data(builder, &mesh->indextype, &nbytes);
+    if (mesh->indices) {
+        parg_buffer_respecify(mesh->indices, indices, nbytes);
+    } else {
+        mesh->indices = parg_buffer_create(
+            (void*) indices, nbytes, PARG_GPU_ELEMENTS);
+    }
+    free(mesh->submeshes);
+    mesh->submeshes = 0;
+    mesh->nsubmeshes = 0;
+    parg_mesh_indices_changed(mesh, builder->ntriangles);
+}
@@ -0,0 +1,364 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "internal.h"
+#include "kvec.h"
+
+// Bounding volume hierarchy over mesh triangles, built top-down with the
+// binned surface area heuristic from Wald, "On fast Construction of SAH-based
+// Bounding Volume Hierarchies".  The BVH keeps its own copy of the triangle
+// corners, so rays can still be cast after the mesh is sent to the GPU.
+
+#define SAH_BINS 12
+#define MIN_LEAF_SIZE 2
+#define MAX_LEAF_SIZE 8
+#define TRAVERSAL_COST 1.0f
+#define MAX_DEPTH 64
+
+// Leaf nodes have a non-zero count and refer to a range of triangles.
+// Interior nodes have a count of zero and their children are adjacent, with
+// the left child at "first".
+typedef struct {
+    Point3 lower;
+    Point3 upper;
+    int first;
+    int count;
+} bvh_node;
+
+typedef struct {
+    Point3 lower;
+    Point3 upper;
+    int count;
+} bvh_bin;
+
+struct parg_bvh_s {
+    bvh_node* nodes;
+    int nnodes;
+    Point3* corners;
+    int* triangles;
+};
+
+typedef struct {
+    kvec_t(bvh_node) nodes;
+    Point3* lowers;
+    Point3* uppers;
+    Point3* centroids;
+    int* triangles;
+} bvh_builder;
+
+static float half_area(Point3 lower, Point3 upper)
+{
+    Vector3 e = P3Sub(upper, lower);
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+static void empty_box(Point3* lower, Point3* upper)
+{
+    *lower = (Point3){FLT_MAX, FLT_MAX, FLT_MAX};
+    *upper = (Point3){-FLT_MAX, -FLT_MAX, -FLT_MAX};
+}
+
+static void grow_box(Point3* lower, Point3* upper, Point3 p)
+{
+    *lower = P3MinPerElem(*lower, p);
+    *upper = P3MaxPerElem(*upper, p);
+}
+
+static float axis_of(Point3 p, int axis)
+{
+    return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+}
+
+// Finds the cheapest binned split of the given range.  Returns the split
+// cost, or FLT_MAX if the centroids cannot be separated.
+static float find_split(bvh_builder const* builder, int first, int count,
+    int* splitaxis, float* splitpos)
+{
+    Point3 clower, cupper;
+    empty_box(&clower, &cupper);
+    for (int i = first; i < first + count; i++) {
+        grow_box(&clower, &cupper, builder->centroids[builder->triangles[i]]);
+    }
+    float best = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = axis_of(clower, axis), hi = axis_of(cupper, axis);
+        if (hi <= lo) {
+            continue;
+        }
+        bvh_bin bins[SAH_BINS];
+        for (int b = 0; b < SAH_BINS; b++) {
+            empty_box(&bins[b].lower, &bins[b].upper);
+            bins[b].count = 0;
+        }
+        float scale = SAH_BINS / (hi - lo);
+        for (int i = first; i < first + count; i++) {
+            int t = builder->triangles[i];
+            float c = axis_of(builder->centroids[t], axis);
+            int b = PARG_MIN(SAH_BINS - 1, (int) ((c - lo) * scale));
+            bins[b].lower = P3MinPerElem(bins[b].lower, builder->lowers[t]);
+            bins[b].upper = P3MaxPerElem(bins[b].upper, builder->uppers[t]);
+            bins[b].count++;
+        }
+
+        // Sweep from the right to gather suffix areas, then from the left.
+        float rightarea[SAH_BINS];
+        int rightcount[SAH_BINS];
+        Point3 lower, upper;
+        empty_box(&lower, &upper);
+        int n = 0;
+        for (int b = SAH_BINS - 1; b > 0; b--) {
+            if (bins[b].count) {
+                grow_box(&lower, &upper, bins[b].lower);
+                grow_box(&lower, &upper, bins[b].upper);
+            }
+            n += bins[b].count;
+            rightcount[b] = n;
+            rightarea[b] = n ? half_area(lower, upper) : 0;
+        }
+        empty_box(&lower, &upper);
+        n = 0;
+        for (int b = 0; b < SAH_BINS - 1; b++) {
+            if (bins[b].count) {
+                grow_box(&lower, &upper, bins[b].lower);
+                grow_box(&lower, &upper, bins[b].upper);
+            }
+            n += bins[b].count;
+            if (n == 0 || rightcount[b + 1] == 0) {
+                continue;
+            }
+            float cost = n * half_area(lower, upper) +
+                rightcount[b + 1] * rightarea[b + 1];
+            if (cost < best) {
+                best = cost;
+                *splitaxis = axis;
+                *splitpos = lo + (b + 1) / scale;
+            }
+        }
+    }
+    return best;
+}
+
+static void build_node(bvh_builder* builder, int index, int first, int count,
+    int depth)
+{
+    Point3 lower, upper;
+    empty_box(&lower, &upper);
+    for (int i = first; i < first + count; i++) {
+        int t = builder->triangles[i];
+        lower = P3MinPerElem(lower, builder->lowers[t]);
+        upper = P3MaxPerElem(upper, builder->uppers[t]);
+    }
+    bvh_node node = {lower, upper, first, count};
+    kv_A(builder->nodes, index) = node;
+    if (count <= MIN_LEAF_SIZE || depth >= MAX_DEPTH) {
+        return;
+    }
+    int axis = 0;
+    float pos = 0;
+    float cost = find_split(builder, first, count, &axis, &pos);
+    float leafcost = count * half_area(lower, upper);
+    float splitcost = TRAVERSAL_COST * half_area(lower, upper) + cost;
+    if (cost == FLT_MAX || (splitcost >= leafcost && count <= MAX_LEAF_SIZE)) {
+        return;
+    }
+
+    // Partition the triangle range in place.
+    int* tris = builder->triangles;
+    int i = first, j = first + count - 1;
+    while (i <= j) {
+        if (axis_of(builder->centroids[tris[i]], axis) < pos) {
+            i++;
+        } else {
+            PARG_SWAP(int, tris[i], tris[j]);
+            j--;
+        }
+    }
+    int nleft = i - first;
+    if (nleft == 0 || nleft == count) {
+        return;
+    }
+    int left = kv_size(builder->nodes);
+    kv_push(bvh_node, builder->nodes, node);
+    kv_push(bvh_node, builder->nodes, node);
+    kv_A(builder->nodes, index).first = left;
+    kv_A(builder->nodes, index).count = 0;
+    build_node(builder, left, first, nleft, depth + 1);
+    build_node(builder, left + 1, i, count - nleft, depth + 1);
+}
+
+void parg_mesh_build_bvh(parg_mesh* mesh)
+{
+    parg_vertex_attrib const* attrib = &mesh->layout[PARG_MESH_COORD];
+    parg_assert(mesh->coords && !parg_buffer_gpu_check(mesh->coords),
+        "CPU mesh required");
+    parg_assert(attrib->type == PARG_FLOAT && attrib->ncomps >= 2,
+        "BVH requires float coordinates");
+    parg_bvh_free(mesh->bvh);
+    int ntris = mesh->ntriangles;
+    int ncomps = attrib->ncomps;
+    parg_bvh* bvh = calloc(1, sizeof(parg_bvh));
+    bvh->corners = malloc(sizeof(Point3) * ntris * 3);
+    bvh->triangles = malloc(sizeof(int) * ntris);
+    float const* coords = parg_buffer_lock(mesh->coords, PARG_READ);
+    void const* indices = parg_buffer_lock(mesh->indices, PARG_READ);
+    for (int i = 0; i < ntris * 3; i++) {
+        float const* p = coords +
+            parg_mesh_index_at(indices, mesh->indextype, i) * ncomps;
+        bvh->corners[i] = (Point3){p[0], p[1], ncomps > 2 ? p[2] : 0};
+    }
+    parg_buffer_unlock(mesh->indices);
+    parg_buffer_unlock(mesh->coords);
+
+    bvh_builder builder = {{0}};
+    builder.triangles = bvh->triangles;
+    builder.lowers = malloc(sizeof(Point3) * ntris);
+    builder.uppers = malloc(sizeof(Point3) * ntris);
+    builder.centroids = malloc(sizeof(Point3) * ntris);
+    for (int t = 0; t < ntris; t++) {
+        Point3 const* c = bvh->corners + t * 3;
+        builder.lowers[t] = P3MinPerElem(c[0], P3MinPerElem(c[1], c[2]));
+        builder.uppers[t] = P3MaxPerElem(c[0], P3MaxPerElem(c[1], c[2]));
+        builder.centroids[t] = P3Lerp(0.5f, builder.lowers[t],
+            builder.uppers[t]);
+        builder.triangles[t] = t;
+    }
+    kv_init(builder.nodes);
+    kv_resize(bvh_node, builder.nodes, PARG_MAX(1, ntris / 2));
+    bvh_node root = {{0}};
+    kv_push(bvh_node, builder.nodes, root);
+    build_node(&builder, 0, 0, ntris, 0);
+    free(builder.lowers);
+    free(builder.uppers);
+    free(builder.centroids);
+    bvh->nodes = builder.nodes.a;
+    bvh->nnodes = kv_size(builder.nodes);
+    mesh->bvh = bvh;
+}
+
+void parg_bvh_free(parg_bvh* bvh)
+{
+    if (!bvh) {
+        return;
+    }
+    free(bvh->nodes);
+    free(bvh->corners);
+    free(bvh->triangles);
+    free(bvh);
+}
+
+// Avoids infinities in the slab test, which produce NaNs when the ray origin
+// lies exactly on a box face.
+static float safe_inverse(float x)
+{
+    return 1.0f / (fabsf(x) > 1e-20f ? x : copysignf(1e-20f, x));
+}
+
+// Slab test; returns the entry distance or FLT_MAX on a miss.
+static float intersect_box(bvh_node const* node, Point3 origin,
+    Vector3 invdir, float tmax)
+{
+    float tx0 = (node->lower.x - origin.x) * invdir.x;
+    float tx1 = (node->upper.x - origin.x) * invdir.x;
+    float ty0 = (node->lower.y - origin.y) * invdir.y;
+    float ty1 = (node->upper.y - origin.y) * invdir.y;
+    float tz0 = (node->lower.z - origin.z) * invdir.z;
+    float tz1 = (node->upper.z - origin.z) * invdir.z;
+    float tnear = PARG_MAX(PARG_MAX(PARG_MIN(tx0, tx1), PARG_MIN(ty0, ty1)),
+        PARG_MIN(tz0, tz1));
+    float tfar = PARG_MIN(PARG_MIN(PARG_MAX(tx0, tx1), PARG_MAX(ty0, ty1)),
+        PARG_MAX(tz0, tz1));
+    return tnear <= tfar && tfar >= 0 && tnear < tmax ? tnear : FLT_MAX;
+}
+
+// Moller-Trumbore; culls neither face.
+static int intersect_triangle(Point3 const* c, Point3 origin, Vector3 dir,
+    float* t, float* u, float* v)
+{
+    Vector3 e1 = P3Sub(c[1], c[0]);
+    Vector3 e2 = P3Sub(c[2], c[0]);
+    Vector3 p = V3Cross(dir, e2);
+    float det = V3Dot(e1, p);
+    if (fabsf(det) < 1e-12f) {
+        return 0;
+    }
+    float invdet = 1.0f / det;
+    Vector3 s = P3Sub(origin, c[0]);
+    *u = V3Dot(s, p) * invdet;
+    if (*u < 0 || *u > 1) {
+        return 0;
+    }
+    Vector3 q = V3Cross(s, e1);
+    *v = V3Dot(dir, q) * invdet;
+    if (*v < 0 || *u + *v > 1) {
+        return 0;
+    }
+    *t = V3Dot(e2, q) * invdet;
+    return *t >= 0;
+}
+
+int parg_mesh_raycast(
+    parg_mesh* mesh, Point3 origin, Vector3 dir, parg_mesh_hit* hit)
+{
+    if (!mesh->bvh) {
+        parg_mesh_build_bvh(mesh);
+    }
+    parg_bvh const* bvh = mesh->bvh;
+    Vector3 invdir = {safe_inverse(dir.x), safe_inverse(dir.y),
+        safe_inverse(dir.z)};
+    float tmax = FLT_MAX;
+    int found = -1;
+    float hitu = 0, hitv = 0;
+    int stack[MAX_DEPTH * 2 + 2];
+    int nstack = 0;
+    if (mesh->ntriangles > 0 &&
+        intersect_box(bvh->nodes, origin, invdir, tmax) < FLT_MAX) {
+        stack[nstack++] = 0;
+    }
+    while (nstack > 0) {
+        bvh_node const* node = bvh->nodes + stack[--nstack];
+        if (node->count > 0) {
+            for (int i = node->first; i < node->first + node->count; i++) {
+                int tri = bvh->triangles[i];
+                float t, u, v;
+                if (intersect_triangle(bvh->corners + tri * 3, origin, dir,
+                    &t, &u, &v) && t < tmax) {
+                    tmax = t;
+                    found = tri;
+                    hitu = u;
+                    hitv = v;
+                }
+            }
+            continue;
+        }
+
+        // Push the farther child first so that the nearer one is popped next.
+        int left = node->first;
+        float tl = intersect_box(bvh->nodes + left, origin, invdir, tmax);
+        float tr = intersect_box(bvh->nodes + left + 1, origin, invdir, tmax);
+        if (tl > tr) {
+            PARG_SWAP(float, tl, tr);
+            left++;
+            if (tr < FLT_MAX) {
+                stack[nstack++] = left - 1;
+            }
+        } else if (tr < FLT_MAX) {
+            stack[nstack++] = left + 1;
+        }
+        if (tl < FLT_MAX) {
+            stack[nstack++] = left;
+        }
+    }
+    if (found < 0) {
+        return 0;
+    }
+    if (hit) {
+        hit->triangle = found;
+        hit->distance = tmax;
+        hit->u = hitu;
+        hit->v = hitv;
+        hit->position = P3AddV3(origin, V3ScalarMul(dir, tmax));
+    }
+    return 1;
+}
@@ -1,5 +1,7 @@
 #include <parg.h>
+#include <stdlib.h>
 #include "pargl.h"
+#include "internal.h"
 
 void parg_draw_clear()
 {
@@ -17,37 +19,151 @@ void parg_draw_triangles(int start, int ntriangles)
     glDrawArrays(GL_TRIANGLES, start * 3, ntriangles * 3);
 }
 
-void parg_draw_triangles_u16(int start, int ntriangles)
+static void draw_elements(GLenum type, int size, int start, int ntriangles)
 {
-    long offset = start * 3 * sizeof(uint16_t);
+    long offset = start * 3 * size;
     const GLvoid* ptr = (const GLvoid*) offset;
-    glDrawElements(GL_TRIANGLES, ntriangles * 3, GL_UNSIGNED_SHORT, ptr);
+    glDrawElements(GL_TRIANGLES, ntriangles * 3, type, ptr);
 }
 
-void parg_draw_instanced_triangles_u16(
-    int start, int ntriangles, int ninstances)
+static void draw_instanced_elements(
+    GLenum type, int size, int start, int ntriangles, int ninstances)
 {
-    long offset = start * 3 * sizeof(uint16_t);
+    long offset = start * 3 * size;
     const GLvoid* ptr = (const GLvoid*) offset;
     pargDrawElementsInstanced(
-        GL_TRIANGLES, ntriangles * 3, GL_UNSIGNED_SHORT, ptr, ninstances);
+        GL_TRIANGLES, ntriangles * 3, type, ptr, ninstances);
 }
 
-void parg_draw_wireframe_triangles_u16(int start, int ntriangles)
+static void draw_wireframe_elements(
+    GLenum type, int size, int start, int ntriangles)
 {
 #ifndef EMSCRIPTEN
     glLineWidth(2);
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     glPolygonOffset(0.0001, -0.0001);
-    glEnable(GL_POLYGON_OFFSET_LINE);
-    long offset = start * 3 * sizeof(uint16_t);
-    const GLvoid* ptr = (const GLvoid*) offset;
-    glDrawElements(GL_TRIANGLES, ntriangles * 3, GL_UNSIGNED_SHORT, ptr);
+    parg_state_enable(GL_POLYGON_OFFSET_LINE, 1);
+    draw_elements(type, size, start, ntriangles);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glDisable(GL_POLYGON_OFFSET_LINE);
+    parg_state_enable(GL_POLYGON_OFFSET_LINE, 0);
 #endif
 }
 
+void parg_draw_triangles_u16(int start, int ntriangles)
+{
+    draw_elements(GL_UNSIGNED_SHORT, sizeof(uint16_t), start, ntriangles);
+}
+
+void parg_draw_instanced_triangles_u16(
+    int start, int ntriangles, int ninstances)
+{
+    draw_instanced_elements(
+        GL_UNSIGNED_SHORT, sizeof(uint16_t), start, ntriangles, ninstances);
+}
+
+void parg_draw_wireframe_triangles_u16(int start, int ntriangles)
+{
+    draw_wireframe_elements(
+        GL_UNSIGNED_SHORT, sizeof(uint16_t), start, ntriangles);
+}
+
+// WebGL 1.0 requires the OES_element_index_uint extension for these; see
+// parg_mesh_split_u16 for an alternative.
+
+void parg_draw_triangles_u32(int start, int ntriangles)
+{
+    draw_elements(GL_UNSIGNED_INT, sizeof(uint32_t), start, ntriangles);
+}
+
+void parg_draw_instanced_triangles_u32(
+    int start, int ntriangles, int ninstances)
+{
+    draw_instanced_elements(
+        GL_UNSIGNED_INT, sizeof(uint32_t), start, ntriangles, ninstances);
+}
+
+void parg_draw_wireframe_triangles_u32(int start, int ntriangles)
+{
+    draw_wireframe_elements(
+        GL_UNSIGNED_INT, sizeof(uint32_t), start, ntriangles);
+}
+
+// Draws ranges of the mesh's shared index buffer, which must already be
+// bound, e.g. with parg_varray_enable_mesh or parg_varray_mesh_layout.
+
+void parg_draw_submesh(parg_mesh* mesh, int index)
+{
+    parg_assert(index >= 0 && index < mesh->nsubmeshes, "Bad sub-mesh index");
+    parg_submesh const* submesh = mesh->submeshes + index;
+    int size = parg_data_type_size(mesh->indextype);
+    draw_elements(mesh->indextype, size, submesh->start, submesh->ntriangles);
+}
+
+static GLsizei* _counts = 0;
+static const GLvoid** _offsets = 0;
+
+static void reserve_ranges(int count)
+{
+    static int capacity = 0;
+    if (count > capacity) {
+        capacity = count;
+        _counts = realloc(_counts, sizeof(GLsizei) * capacity);
+        _offsets = realloc(_offsets, sizeof(GLvoid*) * capacity);
+    }
+}
+
+static void set_range(parg_mesh* mesh, int i, int start, int ntriangles)
+{
+    long offset = start * 3 * parg_data_type_size(mesh->indextype);
+    _counts[i] = ntriangles * 3;
+    _offsets[i] = (const GLvoid*) offset;
+}
+
+static void draw_ranges(parg_mesh* mesh, int count)
+{
+    pargMultiDrawElements(GL_TRIANGLES, _counts, mesh->indextype,
+        (const GLvoid* const*) _offsets, count);
+}
+
+void parg_draw_submeshes(parg_mesh* mesh, int const* indices, int count)
+{
+    reserve_ranges(count);
+    for (int i = 0; i < count; i++) {
+        parg_assert(indices[i] >= 0 && indices[i] < mesh->nsubmeshes,
+            "Bad sub-mesh index");
+        parg_submesh const* submesh = mesh->submeshes + indices[i];
+        set_range(mesh, i, submesh->start, submesh->ntriangles);
+    }
+    draw_ranges(mesh, count);
+}
+
+// Draws the meshlets returned by parg_mesh_cull_meshlets, merging adjacent
+// ranges since culling usually leaves long runs of visible meshlets.
+void parg_draw_meshlets(parg_mesh* mesh, int const* indices, int count)
+{
+    reserve_ranges(count);
+    int nranges = 0;
+    int start = 0, ntriangles = 0;
+    for (int i = 0; i < count; i++) {
+        parg_assert(indices[i] >= 0 && indices[i] < mesh->nmeshlets,
+            "Bad meshlet index");
+        parg_meshlet const* meshlet = mesh->meshlets + indices[i];
+        if (ntriangles && start + ntriangles == meshlet->start) {
+            ntriangles += meshlet->ntriangles;
+            continue;
+        }
+        if (ntriangles) {
+            set_range(mesh, nranges++, start, ntriangles);
+        }
+        start = meshlet->start;
+        ntriangles = meshlet->ntriangles;
+    }
+    if (ntriangles) {
+        set_range(mesh, nranges++, start, ntriangles);
+    }
+    draw_ranges(mesh, nranges);
+}
+
 void parg_draw_lines(int nsegments)
 {
     glLineWidth(2);
@@ -57,9 +173,9 @@ void parg_draw_lines(int nsegments)
 void parg_draw_points(int npoints)
 {
 #if defined(GL_PROGRAM_POINT_SIZE)
-    glEnable(GL_PROGRAM_POINT_SIZE);
+    parg_state_enable(GL_PROGRAM_POINT_SIZE, 1);
 #elif defined(GL_VERTEX_PROGRAM_POINT_SIZE)
-    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    parg_state_enable(GL_VERTEX_PROGRAM_POINT_SIZE, 1);
 #endif
     glDrawArrays(GL_POINTS, 0, npoints);
 }
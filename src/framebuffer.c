@@ -35,7 +35,7 @@ parg_framebuffer* parg_framebuffer_create_empty(
     }
 
     glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
+    parg_state_bind_texture(0, tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
     glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type, 0);
@@ -44,7 +44,7 @@ parg_framebuffer* parg_framebuffer_create_empty(
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
 
     glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    parg_state_bind_framebuffer(fbo);
     glFramebufferTexture2D(
         GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
 
@@ -62,7 +62,7 @@ parg_framebuffer* parg_framebuffer_create_empty(
         printf("Failed to create FBO.\n");
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    parg_state_bind_framebuffer(previous);
 
     parg_framebuffer* framebuffer = malloc(sizeof(struct parg_framebuffer_s));
     framebuffer->width = width;
@@ -90,6 +90,8 @@ parg_framebuffer* parg_framebuffer_create(
 
 void parg_framebuffer_free(parg_framebuffer* framebuffer)
 {
+    parg_state_forget_texture(framebuffer->tex);
+    parg_state_forget_framebuffer(framebuffer->fbo);
     glDeleteTextures(1, &framebuffer->tex);
     glDeleteFramebuffers(1, &framebuffer->fbo);
     free(framebuffer);
@@ -97,14 +99,13 @@ void parg_framebuffer_free(parg_framebuffer* framebuffer)
 
 void parg_framebuffer_bindtex(parg_framebuffer* fbo, int stage)
 {
-    glActiveTexture(GL_TEXTURE0 + stage);
-    glBindTexture(GL_TEXTURE_2D, fbo->tex);
+    parg_state_bind_texture(stage, fbo->tex);
 }
 
 void parg_framebuffer_bindfbo(parg_framebuffer* fbo, int mrt_index)
 {
     // MRT is not supported.
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo->fbo);
+    parg_state_bind_framebuffer(fbo->fbo);
 }
 
 void parg_framebuffer_swap(parg_framebuffer* a, parg_framebuffer* b)
@@ -125,7 +126,7 @@ void parg_framebuffer_pushfbo(parg_framebuffer* fbo, int mrt_index)
 
 void parg_framebuffer_popfbo()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, pushed_fbo);
+    parg_state_bind_framebuffer(pushed_fbo);
     glViewport(pushed_viewport[0], pushed_viewport[1], pushed_viewport[2],
         pushed_viewport[3]);
 }
@@ -8,24 +8,112 @@
 extern "C" {
 #endif
 
+enum {
+    PARG_MESH_COORD,
+    PARG_MESH_UV,
+    PARG_MESH_NORMAL,
+    PARG_MESH_TANGENT,
+    PARG_MESH_NATTRIBS
+};
+
+typedef struct {
+    int ncomps;
+    parg_data_type type;
+    int normalized;
+    int offset;
+} parg_vertex_attrib;
+
+typedef struct {
+    int start;
+    int ntriangles;
+    float error;
+} parg_mesh_lod;
+
+typedef struct {
+    int start;
+    int ntriangles;
+    parg_token name;
+    Point3 lower;
+    Point3 upper;
+} parg_submesh;
+
+typedef struct {
+    int start;
+    int ntriangles;
+    Point3 center;
+    float radius;
+    Vector3 coneaxis;
+    float conecutoff;
+} parg_meshlet;
+
+typedef struct parg_bvh_s parg_bvh;
+
+// Vertex data lives either in the separate attribute buffers, or in
+// the single interleaved "vertices" buffer in which case stride is non-zero.
 struct parg_mesh_s {
     parg_buffer* coords;
     parg_buffer* uvs;
     parg_buffer* normals;
+    parg_buffer* tangents;
     parg_buffer* indices;
+    parg_buffer* vertices;
+    parg_vertex_attrib layout[PARG_MESH_NATTRIBS];
+    int stride;
+    Matrix4 dequantize;
+    parg_data_type indextype;
     int ntriangles;
+    parg_mesh_lod* lods;
+    int nlods;
+    parg_submesh* submeshes;
+    int nsubmeshes;
+    parg_meshlet* meshlets;
+    int nmeshlets;
+    parg_bvh* bvh;
+    parg_varray_layout* varrays;
 };
 
+static inline uint32_t parg_mesh_index_at(
+    void const* indices, parg_data_type indextype, int i)
+{
+    return indextype == PARG_UINT ? ((uint32_t const*) indices)[i]
+        : ((uint16_t const*) indices)[i];
+}
+
 void parg_load_obj(parg_mesh* mesh, parg_buffer* buffer);
-sds parg_token_to_sds(parg_token token);
+int parg_pmesh_check(void const* data, int nbytes);
+void parg_load_pmesh(parg_mesh* mesh, void const* data, int nbytes);
+int parg_load_pmesh_file(parg_mesh* mesh, const char* filepath);
+parg_mesh* parg_mesh_alloc(int coordcomps);
+int parg_data_type_size(parg_data_type type);
+int parg_mesh_nverts(parg_mesh* mesh);
+void parg_mesh_compute_submesh_bounds(parg_mesh* mesh);
+uint32_t* parg_mesh_read_indices(parg_mesh* mesh);
+void parg_mesh_write_indices(parg_mesh* mesh, uint32_t const* src, int ntris);
+void parg_mesh_indices_changed(parg_mesh* mesh, int ntris);
+uint32_t parg_buffer_serial(parg_buffer* buf);
+void parg_varray_unbind_layout();
+void parg_varray_free_mesh_layouts(parg_mesh* mesh);
+void parg_mesh_remap_vertices(
+    parg_mesh* mesh, int nverts, int const* remap, int newcount);
+void parg_bvh_free(parg_bvh* bvh);
+
+typedef void (*parg_range_fn)(int begin, int end, void* userdata);
+void parg_parallel_for(int count, int grain, parg_range_fn fn, void* userdata);
+int parg_thread_count();
 parg_buffer* parg_buffer_from_path(const char* filepath);
+void parg_buffer_respecify(parg_buffer* buf, void const* src, int nbytes);
 sds parg_asset_whereami();
+sds parg_uniformblock_declare(sds name, sds const* lines, int nlines);
+const char* parg_uniformblock_glsl_prefix();
 void parg_asset_set_baseurl(const char* url);
 sds parg_asset_baseurl();
 int parg_asset_fileexists(sds fullpath);
 int parg_asset_download(const char* filename, sds targetpath);
 parg_buffer* parg_asset_to_buffer(parg_token id);
 
+#define PARG_HASH_SEED 14695981039346656037ull
+uint64_t parg_hash_bytes(void const* data, int nbytes, uint64_t seed);
+
 // This takes two human-readable strings: the key and the metadata. The key
 // should not be generated by sprintf because it is used as a grouping key in
 // systems like Sentry.  The metadata, on the other hand, can be unique.
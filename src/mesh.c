@@ -5,192 +5,56 @@
 #include <memory.h>
 #include <assert.h>
 #include "internal.h"
+#include "kvec.h"
+
+parg_mesh* parg_mesh_alloc(int coordcomps)
+{
+    parg_mesh* surf = calloc(sizeof(struct parg_mesh_s), 1);
+    surf->indextype = PARG_USHORT;
+    surf->layout[PARG_MESH_COORD] = (parg_vertex_attrib){coordcomps,
+        PARG_FLOAT, 0, 0};
+    surf->layout[PARG_MESH_UV] = (parg_vertex_attrib){2, PARG_FLOAT, 0, 0};
+    surf->layout[PARG_MESH_NORMAL] = (parg_vertex_attrib){3, PARG_FLOAT, 0, 0};
+    surf->layout[PARG_MESH_TANGENT] = (parg_vertex_attrib){3, PARG_FLOAT, 0, 0};
+    surf->dequantize = M4MakeIdentity();
+    return surf;
+}
 
 parg_mesh* parg_mesh_create(float* pts, int npts, uint16_t* tris, int ntris)
 {
-    parg_mesh* surf = malloc(sizeof(struct parg_mesh_s));
+    parg_mesh* surf = parg_mesh_alloc(3);
     surf->coords =
         parg_buffer_create(pts, npts * sizeof(float) * 3, PARG_GPU_ARRAY);
     surf->uvs = 0;
     surf->normals = 0;
     surf->indices = parg_buffer_create(
         tris, ntris * sizeof(uint16_t) * 3, PARG_GPU_ELEMENTS);
+    surf->indextype = PARG_USHORT;
     surf->ntriangles = ntris;
     return surf;
 }
 
-static Point3 torus_fn(float major, float minor, float phi, float theta)
-{
-    float beta = major + minor * cos(phi);
-    Point3 p;
-    p.x = cos(theta) * beta;
-    p.y = sin(theta) * beta;
-    p.z = sin(phi) * minor;
-    return p;
-}
-
-Point3 knot_fn(float s, float t)
+parg_mesh* parg_mesh_create_u32(
+    float* pts, int npts, uint32_t* tris, int ntris)
 {
-    const float a = 0.5f;
-    const float b = 0.3f;
-    const float c = 0.5f;
-    const float d = 0.1f;
-    const float u = (1 - s) * 2 * PARG_TWOPI;
-    const float v = t * PARG_TWOPI;
-    const float r = a + b * cos(1.5f * u);
-    const float x = r * cos(u);
-    const float y = r * sin(u);
-    const float z = c * sin(1.5f * u);
-
-    Vector3 dv;
-    dv.x =
-        -1.5f * b * sin(1.5f * u) * cos(u) - (a + b * cos(1.5f * u)) * sin(u);
-    dv.y =
-        -1.5f * b * sin(1.5f * u) * sin(u) + (a + b * cos(1.5f * u)) * cos(u);
-    dv.z = 1.5f * c * cos(1.5f * u);
-
-    Vector3 q = V3Normalize(dv);
-    Vector3 qvn = V3Normalize((Vector3){q.y, -q.x, 0});
-    Vector3 ww = V3Cross(q, qvn);
-
-    Point3 range;
-    range.x = x + d * (qvn.x * cos(v) + ww.x * sin(v));
-    range.y = y + d * (qvn.y * cos(v) + ww.y * sin(v));
-    range.z = z + d * ww.z * sin(v);
-    return range;
-}
-
-parg_mesh* parg_mesh_knot(int slices, int stacks, float major, float minor)
-{
-    parg_mesh* surf = malloc(sizeof(struct parg_mesh_s));
-    float ds = 1.0f / slices;
-    float dt = 1.0f / stacks;
-    int vertexCount = slices * stacks * 3;
-    int vertexStride = sizeof(float) * 3;
+    parg_mesh* surf = parg_mesh_alloc(3);
     surf->coords =
-        parg_buffer_alloc(vertexCount * vertexStride, PARG_GPU_ARRAY);
-    surf->normals =
-        parg_buffer_alloc(vertexCount * vertexStride, PARG_GPU_ARRAY);
-    surf->uvs = 0;
-    Point3* position = (Point3*) parg_buffer_lock(surf->coords, PARG_WRITE);
-    Vector3* normal = (Vector3*) parg_buffer_lock(surf->normals, PARG_WRITE);
-    for (float s = 0; s < 1 - ds / 2; s += ds) {
-        for (float t = 0; t < 1 - dt / 2; t += dt) {
-            const float E = 0.01f;
-            Point3 p = knot_fn(s, t);
-            Vector3 u = P3Sub(knot_fn(s + E, t), p);
-            Vector3 v = P3Sub(knot_fn(s, t + E), p);
-            Vector3 n = V3Normalize(V3Cross(u, v));
-            *position++ = p;
-            *normal++ = n;
-        }
-    }
-    parg_buffer_unlock(surf->coords);
-    parg_buffer_unlock(surf->normals);
-
-    surf->ntriangles = slices * stacks * 2;
-    int indexCount = surf->ntriangles * 3;
-    surf->indices = parg_buffer_alloc(indexCount * 2, PARG_GPU_ELEMENTS);
-    uint16_t* index = (uint16_t*) parg_buffer_lock(surf->indices, PARG_WRITE);
-    int v = 0;
-    for (int i = 0; i < slices - 1; i++) {
-        for (int j = 0; j < stacks; j++) {
-            int next = (j + 1) % stacks;
-            *index++ = v + next + stacks;
-            *index++ = v + next;
-            *index++ = v + j;
-            *index++ = v + j;
-            *index++ = v + j + stacks;
-            *index++ = v + next + stacks;
-        }
-        v += stacks;
-    }
-    for (int j = 0; j < stacks; j++) {
-        int next = (j + 1) % stacks;
-        *index++ = next;
-        *index++ = v + next;
-        *index++ = v + j;
-        *index++ = v + j;
-        *index++ = j;
-        *index++ = next;
-    }
-    parg_buffer_unlock(surf->indices);
-    return surf;
-}
-
-parg_mesh* parg_mesh_torus(int slices, int stacks, float major, float minor)
-{
-    parg_mesh* surf = malloc(sizeof(struct parg_mesh_s));
-    float dphi = PARG_TWOPI / stacks;
-    float dtheta = PARG_TWOPI / slices;
-    int vertexCount = slices * stacks * 3;
-    int vertexStride = sizeof(float) * 3;
-    surf->coords =
-        parg_buffer_alloc(vertexCount * vertexStride, PARG_GPU_ARRAY);
+        parg_buffer_create(pts, npts * sizeof(float) * 3, PARG_GPU_ARRAY);
     surf->uvs = 0;
-    Point3* position = (Point3*) parg_buffer_lock(surf->coords, PARG_WRITE);
-    for (int slice = 0; slice < slices; slice++) {
-        float theta = slice * dtheta;
-        for (int stack = 0; stack < stacks; stack++) {
-            float phi = stack * dphi;
-            *position++ = torus_fn(major, minor, phi, theta);
-        }
-    }
-    parg_buffer_unlock(surf->coords);
-
-    surf->normals =
-        parg_buffer_alloc(vertexCount * vertexStride, PARG_GPU_ARRAY);
-    Vector3* normal = (Vector3*) parg_buffer_lock(surf->normals, PARG_WRITE);
-    for (int slice = 0; slice < slices; slice++) {
-        float theta = slice * dtheta;
-        for (int stack = 0; stack < stacks; stack++) {
-            float phi = stack * dphi;
-            Point3 p = torus_fn(major, minor, phi, theta);
-            Point3 p1 = torus_fn(major, minor, phi, theta + 0.01);
-            Point3 p2 = torus_fn(major, minor, phi + 0.01, theta);
-            Vector3 du = P3Sub(p2, p);
-            Vector3 dv = P3Sub(p1, p);
-            *normal = V3Normalize(V3Cross(du, dv));
-            ++normal;
-        }
-    }
-    parg_buffer_unlock(surf->normals);
-
-    surf->ntriangles = slices * stacks * 2;
-    int indexCount = surf->ntriangles * 3;
-    surf->indices = parg_buffer_alloc(indexCount * 2, PARG_GPU_ELEMENTS);
-    uint16_t* index = (uint16_t*) parg_buffer_lock(surf->indices, PARG_WRITE);
-    int v = 0;
-    for (int i = 0; i < slices - 1; i++) {
-        for (int j = 0; j < stacks; j++) {
-            int next = (j + 1) % stacks;
-            *index++ = v + next + stacks;
-            *index++ = v + next;
-            *index++ = v + j;
-            *index++ = v + j;
-            *index++ = v + j + stacks;
-            *index++ = v + next + stacks;
-        }
-        v += stacks;
-    }
-    for (int j = 0; j < stacks; j++) {
-        int next = (j + 1) % stacks;
-        *index++ = next;
-        *index++ = v + next;
-        *index++ = v + j;
-        *index++ = v + j;
-        *index++ = j;
-        *index++ = next;
-    }
-    parg_buffer_unlock(surf->indices);
+    surf->normals = 0;
+    surf->indices = parg_buffer_create(
+        tris, ntris * sizeof(uint32_t) * 3, PARG_GPU_ELEMENTS);
+    surf->indextype = PARG_UINT;
+    surf->ntriangles = ntris;
     return surf;
 }
 
 parg_mesh* parg_mesh_aar(parg_aar rect)
 {
-    parg_mesh* surf = malloc(sizeof(struct parg_mesh_s));
+    parg_mesh* surf = parg_mesh_alloc(2);
     surf->normals = 0;
     surf->indices = 0;
+    surf->indextype = PARG_USHORT;
     surf->ntriangles = 2;
     int vertexCount = 4;
     int vertexStride = sizeof(float) * 2;
@@ -226,78 +90,211 @@ parg_mesh* parg_mesh_rectangle(float width, float height)
     return parg_mesh_aar((parg_aar){-w, -h, w, h});
 }
 
-parg_mesh* parg_mesh_sierpinski(float width, int depth)
+// Leaf triangles of the Sierpinski gasket are computed directly from their
+// base-3 index, where the most significant digit selects the corner at the
+// first level of subdivision.  Each subdivision maps the triangle toward one
+// of its corners with p -> (p + corner) / 2, so a leaf is the root scaled by
+// 2^-depth and offset by the sum of the selected corners weighted by 2^-k.
+// Shared vertices are numbered by the level, parent triangle, and edge that
+// created them as midpoints, after the three root corners.
+
+#define SIERPINSKI_GRAIN 4096
+
+// Beyond depth 16, the non-indexed coordinate buffer exceeds the 2 GB that
+// an int byte count can describe.
+#define SIERPINSKI_MAX_DEPTH 16
+
+typedef struct {
+    double x[3];
+    double y[3];
+    int depth;
+    int pow3[SIERPINSKI_MAX_DEPTH + 2];
+    double weights[SIERPINSKI_MAX_DEPTH + 1][3][2];
+    float* coords;
+    void* indices;
+    parg_data_type indextype;
+} sierpinski_job;
+
+// Walks the triangles of one level like an odometer over their base-3
+// digits, so that only the levels below a carry need their partial offsets
+// and ancestor indices recomputed.
+typedef struct {
+    int level;
+    int dirty;
+    int digits[SIERPINSKI_MAX_DEPTH + 1];
+    int ancestors[SIERPINSKI_MAX_DEPTH + 1];
+    double partials[SIERPINSKI_MAX_DEPTH + 1][2];
+} sierpinski_cursor;
+
+static void cursor_init(sierpinski_cursor* cursor, int index, int level)
 {
-    parg_mesh* surf = malloc(sizeof(struct parg_mesh_s));
-    surf->normals = 0;
-    surf->indices = 0;
-    surf->uvs = 0;
-    surf->ntriangles = pow(3, depth);
-    int vstride = sizeof(float) * 2;
-    int ntriangles = 1;
-    int nverts = ntriangles * 3;
-    float height = width * sqrt(0.75);
-
-    parg_buffer* src = parg_buffer_alloc(nverts * vstride, PARG_CPU);
-    float* psrc = (float*) parg_buffer_lock(src, PARG_WRITE);
-    *psrc++ = 0;
-    *psrc++ = height * 0.5;
-    *psrc++ = width * 0.5;
-    *psrc++ = -height * 0.5;
-    *psrc++ = -width * 0.5;
-    *psrc++ = -height * 0.5;
-    parg_buffer_unlock(src);
-
-#define WRITE_TRIANGLE(a, b, c) \
-    *pdst++ = x[a];             \
-    *pdst++ = y[a];             \
-    *pdst++ = x[b];             \
-    *pdst++ = y[b];             \
-    *pdst++ = x[c];             \
-    *pdst++ = y[c]
-
-    float x[6];
-    float y[6];
-    while (depth--) {
-        ntriangles *= 3;
-        nverts = ntriangles * 3;
-        parg_buffer* dst = parg_buffer_alloc(nverts * vstride, PARG_CPU);
-        float* pdst = parg_buffer_lock(dst, PARG_WRITE);
-        const float* psrc = parg_buffer_lock(src, PARG_READ);
-        for (int i = 0; i < ntriangles / 3; i++) {
-            x[0] = *psrc++;
-            y[0] = *psrc++;
-            x[1] = *psrc++;
-            y[1] = *psrc++;
-            x[2] = *psrc++;
-            y[2] = *psrc++;
-            x[3] = 0.5 * (x[0] + x[1]);
-            y[3] = 0.5 * (y[0] + y[1]);
-            x[4] = 0.5 * (x[1] + x[2]);
-            y[4] = 0.5 * (y[1] + y[2]);
-            x[5] = 0.5 * (x[0] + x[2]);
-            y[5] = 0.5 * (y[0] + y[2]);
-            WRITE_TRIANGLE(0, 3, 5);
-            WRITE_TRIANGLE(3, 1, 4);
-            WRITE_TRIANGLE(5, 4, 2);
+    cursor->level = level;
+    cursor->dirty = 1;
+    cursor->ancestors[0] = 0;
+    cursor->partials[0][0] = cursor->partials[0][1] = 0;
+    for (int k = level; k > 0; k--, index /= 3) {
+        cursor->digits[k] = index % 3;
+    }
+}
+
+static void cursor_update(
+    sierpinski_job const* job, sierpinski_cursor* cursor)
+{
+    for (int k = cursor->dirty; k <= cursor->level; k++) {
+        double const* w = job->weights[k][cursor->digits[k]];
+        cursor->partials[k][0] = cursor->partials[k - 1][0] + w[0];
+        cursor->partials[k][1] = cursor->partials[k - 1][1] + w[1];
+        cursor->ancestors[k] =
+            cursor->ancestors[k - 1] * 3 + cursor->digits[k];
+    }
+    cursor->dirty = cursor->level + 1;
+}
+
+static void cursor_advance(sierpinski_cursor* cursor)
+{
+    int k = cursor->level;
+    for (; k > 0 && ++cursor->digits[k] == 3; k--) {
+        cursor->digits[k] = 0;
+    }
+    cursor->dirty = PARG_MAX(k, 1);
+}
+
+static void sierpinski_leaves(int begin, int end, void* userdata)
+{
+    sierpinski_job const* job = userdata;
+    int depth = job->depth;
+    double scale = ldexp(1.0, -depth);
+    sierpinski_cursor cursor;
+    cursor_init(&cursor, begin, depth);
+    for (int i = begin; i < end; i++, cursor_advance(&cursor)) {
+        cursor_update(job, &cursor);
+        int const* digits = cursor.digits;
+        for (int c = 0; c < 3 && job->indices; c++) {
+            uint32_t id = c;
+            for (int k = depth; k > 0; k--) {
+                if (digits[k] != c) {
+                    id = 3 + (job->pow3[k] - 3) / 2 +
+                        cursor.ancestors[k - 1] * 3 + c + digits[k] - 1;
+                    break;
+                }
+            }
+            if (job->indextype == PARG_UINT) {
+                ((uint32_t*) job->indices)[i * 3 + c] = id;
+            } else {
+                ((uint16_t*) job->indices)[i * 3 + c] = id;
+            }
+        }
+        if (!job->indices) {
+            double const* offset = cursor.partials[depth];
+            float* dst = job->coords + i * 6;
+            for (int c = 0; c < 3; c++) {
+                *dst++ = offset[0] + scale * job->x[c];
+                *dst++ = offset[1] + scale * job->y[c];
+            }
         }
-        parg_buffer_unlock(src);
-        parg_buffer_unlock(dst);
-        parg_buffer_free(src);
-        src = dst;
     }
+}
 
-    assert(surf->ntriangles == ntriangles);
+// Vertices after the root corners are grouped by the level that created
+// them, then by parent triangle, then by edge.
+static void sierpinski_vertices(int begin, int end, void* userdata)
+{
+    sierpinski_job const* job = userdata;
+    int v = begin;
+    for (; v < PARG_MIN(end, 3); v++) {
+        job->coords[v * 2] = job->x[v];
+        job->coords[v * 2 + 1] = job->y[v];
+    }
+    if (v == end) {
+        return;
+    }
+    int level = 1;
+    while (3 + (job->pow3[level + 1] - 3) / 2 <= v) {
+        level++;
+    }
+    int r = v - 3 - (job->pow3[level] - 3) / 2;
+    int parent = r / 3;
+    int edge = r % 3;
+    sierpinski_cursor cursor;
+    cursor_init(&cursor, parent, level - 1);
+    while (v < end) {
+        cursor_update(job, &cursor);
+        double const* offset = cursor.partials[level - 1];
+        double scale = ldexp(1.0, -level);
+        for (; edge < 3 && v < end; edge++, v++) {
+            int a = edge == 2 ? 1 : 0;
+            int b = edge == 0 ? 1 : 2;
+            job->coords[v * 2] = offset[0] + scale * (job->x[a] + job->x[b]);
+            job->coords[v * 2 + 1] =
+                offset[1] + scale * (job->y[a] + job->y[b]);
+        }
+        edge = 0;
+        if (++parent == job->pow3[level - 1]) {
+            level++;
+            parent = 0;
+            cursor_init(&cursor, 0, level - 1);
+        } else {
+            cursor_advance(&cursor);
+        }
+    }
+}
+
+static parg_mesh* sierpinski(float width, int depth, int indexed)
+{
+    parg_assert(depth >= 0 && depth <= SIERPINSKI_MAX_DEPTH,
+        "Bad Sierpinski depth");
+    double height = width * sqrt(0.75);
+    sierpinski_job job = {
+        {0, width * 0.5, -width * 0.5},
+        {height * 0.5, -height * 0.5, -height * 0.5}, depth};
+    job.pow3[0] = 1;
+    for (int k = 1; k <= depth + 1; k++) {
+        job.pow3[k] = job.pow3[k - 1] * 3;
+    }
+    for (int k = 1; k <= depth; k++) {
+        for (int c = 0; c < 3; c++) {
+            job.weights[k][c][0] = ldexp(job.x[c], -k);
+            job.weights[k][c][1] = ldexp(job.y[c], -k);
+        }
+    }
+    parg_mesh* surf = parg_mesh_alloc(2);
+    surf->indextype = PARG_USHORT;
+    surf->ntriangles = job.pow3[depth];
+    int vstride = sizeof(float) * 2;
+    int nverts = surf->ntriangles * 3;
+    if (indexed) {
+        nverts = (job.pow3[depth + 1] + 3) / 2;
+        surf->indextype = nverts > 0x10000 ? PARG_UINT : PARG_USHORT;
+        job.indextype = surf->indextype;
+        int size = parg_data_type_size(surf->indextype);
+        surf->indices = parg_buffer_alloc(
+            surf->ntriangles * 3 * size, PARG_GPU_ELEMENTS);
+        job.indices = parg_buffer_lock(surf->indices, PARG_WRITE);
+    }
     surf->coords = parg_buffer_alloc(nverts * vstride, PARG_GPU_ARRAY);
-    float* pdst = parg_buffer_lock(surf->coords, PARG_WRITE);
-    psrc = parg_buffer_lock(src, PARG_READ);
-    memcpy(pdst, psrc, nverts * vstride);
-    parg_buffer_unlock(src);
+    job.coords = parg_buffer_lock(surf->coords, PARG_WRITE);
+    parg_parallel_for(
+        surf->ntriangles, SIERPINSKI_GRAIN, sierpinski_leaves, &job);
+    if (indexed) {
+        parg_parallel_for(nverts, SIERPINSKI_GRAIN, sierpinski_vertices, &job);
+        parg_buffer_unlock(surf->indices);
+    }
     parg_buffer_unlock(surf->coords);
-    parg_buffer_free(src);
     return surf;
 }
 
+parg_mesh* parg_mesh_sierpinski(float width, int depth)
+{
+    return sierpinski(width, depth, 0);
+}
+
+// Shares the vertices where triangles touch, which halves the amount of
+// vertex data.  These meshes must be drawn with the indexed draw functions.
+parg_mesh* parg_mesh_sierpinski_indexed(float width, int depth)
+{
+    return sierpinski(width, depth, 1);
+}
+
 void parg_mesh_free(parg_mesh* m)
 {
     if (!m) {
@@ -306,7 +303,14 @@ void parg_mesh_free(parg_mesh* m)
     parg_buffer_free(m->coords);
     parg_buffer_free(m->indices);
     parg_buffer_free(m->normals);
+    parg_buffer_free(m->tangents);
     parg_buffer_free(m->uvs);
+    parg_buffer_free(m->vertices);
+    free(m->lods);
+    free(m->submeshes);
+    free(m->meshlets);
+    parg_bvh_free(m->bvh);
+    parg_varray_free_mesh_layouts(m);
     free(m);
 }
 
@@ -316,23 +320,133 @@ parg_buffer* parg_mesh_uv(parg_mesh* m) { return m->uvs; }
 
 parg_buffer* parg_mesh_norml(parg_mesh* m) { return m->normals; }
 
+parg_buffer* parg_mesh_tangent(parg_mesh* m) { return m->tangents; }
+
 parg_buffer* parg_mesh_index(parg_mesh* m) { return m->indices; }
 
+parg_buffer* parg_mesh_vertices(parg_mesh* m) { return m->vertices; }
+
+int parg_mesh_stride(parg_mesh* m) { return m->stride; }
+
 int parg_mesh_ntriangles(parg_mesh* m) { return m->ntriangles; }
 
+parg_data_type parg_mesh_index_type(parg_mesh* m) { return m->indextype; }
+
+int parg_mesh_nsubmeshes(parg_mesh* m) { return m->nsubmeshes; }
+
+int parg_mesh_submesh_find(parg_mesh* m, parg_token name)
+{
+    for (int s = 0; s < m->nsubmeshes; s++) {
+        if (m->submeshes[s].name == name) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+parg_token parg_mesh_submesh_name(parg_mesh* m, int index)
+{
+    parg_assert(index >= 0 && index < m->nsubmeshes, "Bad sub-mesh index");
+    return m->submeshes[index].name;
+}
+
+void parg_mesh_submesh_range(parg_mesh* m, int index, int* start, int* ntris)
+{
+    parg_assert(index >= 0 && index < m->nsubmeshes, "Bad sub-mesh index");
+    *start = m->submeshes[index].start;
+    *ntris = m->submeshes[index].ntriangles;
+}
+
+void parg_mesh_submesh_bounds(
+    parg_mesh* m, int index, Point3* lower, Point3* upper)
+{
+    parg_assert(index >= 0 && index < m->nsubmeshes, "Bad sub-mesh index");
+    *lower = m->submeshes[index].lower;
+    *upper = m->submeshes[index].upper;
+}
+
+void parg_mesh_compute_submesh_bounds(parg_mesh* mesh)
+{
+    if (!mesh->nsubmeshes) {
+        return;
+    }
+    parg_vertex_attrib const* attrib = &mesh->layout[PARG_MESH_COORD];
+    parg_assert(mesh->coords && !parg_buffer_gpu_check(mesh->coords) &&
+        attrib->ncomps == 3 && attrib->type == PARG_FLOAT,
+        "Sub-mesh bounds require float3 CPU coordinates");
+    Point3 const* coords = parg_buffer_lock(mesh->coords, PARG_READ);
+    void const* indices = parg_buffer_lock(mesh->indices, PARG_READ);
+    for (int s = 0; s < mesh->nsubmeshes; s++) {
+        parg_submesh* submesh = mesh->submeshes + s;
+        Point3 lower = {INFINITY, INFINITY, INFINITY};
+        Point3 upper = {-INFINITY, -INFINITY, -INFINITY};
+        int first = submesh->start * 3;
+        int last = first + submesh->ntriangles * 3;
+        for (int i = first; i < last; i++) {
+            Point3 p = coords[parg_mesh_index_at(indices, mesh->indextype, i)];
+            lower = P3MinPerElem(lower, p);
+            upper = P3MaxPerElem(upper, p);
+        }
+        submesh->lower = lower;
+        submesh->upper = upper;
+    }
+    parg_buffer_unlock(mesh->indices);
+    parg_buffer_unlock(mesh->coords);
+}
+
+// The bounding sphere is centered on the box, which is not minimal but is
+// cheap and stable.
+void parg_mesh_compute_bounds(parg_mesh* mesh, parg_mesh_bounds* bounds)
+{
+    parg_vertex_attrib const* attrib = &mesh->layout[PARG_MESH_COORD];
+    parg_assert(mesh->coords && !parg_buffer_gpu_check(mesh->coords) &&
+        attrib->ncomps >= 2 && attrib->type == PARG_FLOAT,
+        "Bounds require float CPU coordinates");
+    int ncomps = attrib->ncomps;
+    int nverts = parg_mesh_nverts(mesh);
+    float const* coords = parg_buffer_lock(mesh->coords, PARG_READ);
+    Point3 lower = {INFINITY, INFINITY, INFINITY};
+    Point3 upper = {-INFINITY, -INFINITY, -INFINITY};
+    for (int i = 0; i < nverts; i++, coords += ncomps) {
+        Point3 p = {coords[0], coords[1], ncomps > 2 ? coords[2] : 0};
+        lower = P3MinPerElem(lower, p);
+        upper = P3MaxPerElem(upper, p);
+    }
+    Point3 center = P3Lerp(0.5f, lower, upper);
+    float radius2 = 0;
+    coords -= nverts * ncomps;
+    for (int i = 0; i < nverts; i++, coords += ncomps) {
+        Point3 p = {coords[0], coords[1], ncomps > 2 ? coords[2] : 0};
+        radius2 = PARG_MAX(radius2, P3DistSqr(p, center));
+    }
+    parg_buffer_unlock(mesh->coords);
+    bounds->lower = lower;
+    bounds->upper = upper;
+    bounds->center = center;
+    bounds->radius = sqrtf(radius2);
+}
+
 parg_mesh* parg_mesh_from_asset(parg_token id)
 {
-    parg_mesh* surf = calloc(sizeof(struct parg_mesh_s), 1);
+    parg_mesh* surf = parg_mesh_alloc(3);
     int* rawdata;
     parg_buffer* objbuf = parg_buffer_slurp_asset(id, (void*) &rawdata);
-    parg_load_obj(surf, objbuf);
+    int nbytes = parg_buffer_length(objbuf);
+    if (parg_pmesh_check(rawdata, nbytes)) {
+        parg_load_pmesh(surf, rawdata, nbytes);
+    } else {
+        parg_load_obj(surf, objbuf);
+    }
     parg_buffer_free(objbuf);
     return surf;
 }
 
 parg_mesh* parg_mesh_from_file(const char* filepath)
 {
-    parg_mesh* surf = calloc(sizeof(struct parg_mesh_s), 1);
+    parg_mesh* surf = parg_mesh_alloc(3);
+    if (parg_load_pmesh_file(surf, filepath)) {
+        return surf;
+    }
     parg_buffer* objbuf = parg_buffer_from_file(filepath);
     parg_load_obj(surf, objbuf);
     parg_buffer_free(objbuf);
@@ -341,7 +455,7 @@ parg_mesh* parg_mesh_from_file(const char* filepath)
 
 parg_mesh* parg_mesh_from_shape(struct par_shapes_mesh_s const* src)
 {
-    parg_mesh* dst = calloc(sizeof(struct parg_mesh_s), 1);
+    parg_mesh* dst = parg_mesh_alloc(3);
     dst->coords = parg_buffer_alloc(4 * 3 * src->npoints, PARG_GPU_ARRAY);
     float* pcoords = (float*) parg_buffer_lock(dst->coords, PARG_WRITE);
     memcpy(pcoords, src->points, 4 * 3 * src->npoints);
@@ -358,30 +472,17 @@ parg_mesh* parg_mesh_from_shape(struct par_shapes_mesh_s const* src)
         memcpy(pnorms, src->normals, 4 * 3 * src->npoints);
         parg_buffer_unlock(dst->normals);
     }
+    int isize = sizeof(PAR_SHAPES_T);
     dst->indices =
-        parg_buffer_alloc(2 * 3 * src->ntriangles, PARG_GPU_ELEMENTS);
-    uint16_t* ptris = (uint16_t*) parg_buffer_lock(dst->indices, PARG_WRITE);
-    memcpy(ptris, src->triangles, 2 * 3 * src->ntriangles);
+        parg_buffer_alloc(isize * 3 * src->ntriangles, PARG_GPU_ELEMENTS);
+    void* ptris = parg_buffer_lock(dst->indices, PARG_WRITE);
+    memcpy(ptris, src->triangles, isize * 3 * src->ntriangles);
     parg_buffer_unlock(dst->indices);
+    dst->indextype = isize == 4 ? PARG_UINT : PARG_USHORT;
     dst->ntriangles = src->ntriangles;
     return dst;
 }
 
-void parg_mesh_compute_normals(parg_mesh* mesh)
-{
-    par_shapes_mesh m = {0};
-    int nbytes = parg_buffer_length(mesh->coords);
-    m.points = (float*) parg_buffer_lock(mesh->coords, PARG_READ);
-    m.triangles = (uint16_t*) parg_buffer_lock(mesh->indices, PARG_READ);
-    m.npoints = nbytes / 12;
-    m.ntriangles = mesh->ntriangles;
-    par_shapes_compute_normals(&m);
-    mesh->normals = parg_buffer_create(m.normals, nbytes, PARG_CPU);
-    parg_buffer_unlock(mesh->coords);
-    parg_buffer_unlock(mesh->indices);
-    free(m.normals);
-}
-
 parg_buffer* parg_buffer_to_gpu(parg_buffer* cpubuf, parg_buffer_type memtype)
 {
     int nbytes = parg_buffer_length(cpubuf);
@@ -391,23 +492,212 @@ parg_buffer* parg_buffer_to_gpu(parg_buffer* cpubuf, parg_buffer_type memtype)
     return gpubuf;
 }
 
+static void send_buffer(parg_buffer** buf, parg_buffer_type memtype)
+{
+    if (*buf && !parg_buffer_gpu_check(*buf)) {
+        parg_buffer* gpubuf = parg_buffer_to_gpu(*buf, memtype);
+        parg_buffer_free(*buf);
+        *buf = gpubuf;
+    }
+}
+
+// Buffers that are already GPU-resident, such as those loaded from a pmesh,
+// are left alone.
 void parg_mesh_send_to_gpu(parg_mesh* mesh)
 {
-    parg_buffer* coords = parg_buffer_to_gpu(mesh->coords, PARG_GPU_ARRAY);
-    parg_buffer_free(mesh->coords);
-    mesh->coords = coords;
-    parg_buffer* indices = parg_buffer_to_gpu(mesh->indices, PARG_GPU_ELEMENTS);
-    parg_buffer_free(mesh->indices);
-    mesh->indices = indices;
-    if (mesh->uvs) {
-        parg_buffer* uvs = parg_buffer_to_gpu(mesh->uvs, PARG_GPU_ARRAY);
-        parg_buffer_free(mesh->uvs);
-        mesh->uvs = uvs;
-    }
-    if (mesh->normals) {
-        parg_buffer* normals =
-            parg_buffer_to_gpu(mesh->normals, PARG_GPU_ARRAY);
-        parg_buffer_free(mesh->normals);
-        mesh->normals = normals;
+    send_buffer(&mesh->coords, PARG_GPU_ARRAY);
+    send_buffer(&mesh->vertices, PARG_GPU_ARRAY);
+    send_buffer(&mesh->indices, PARG_GPU_ELEMENTS);
+    send_buffer(&mesh->uvs, PARG_GPU_ARRAY);
+    send_buffer(&mesh->normals, PARG_GPU_ARRAY);
+    send_buffer(&mesh->tangents, PARG_GPU_ARRAY);
+}
+
+int parg_data_type_size(parg_data_type type)
+{
+    switch (type) {
+        case PARG_BYTE:
+        case PARG_UBYTE:
+            return 1;
+        case PARG_SHORT:
+        case PARG_USHORT:
+        case PARG_HALF:
+            return 2;
+        case PARG_DOUBLE:
+            return 8;
+        default:
+            return 4;
+    }
+}
+
+int parg_mesh_nverts(parg_mesh* mesh)
+{
+    if (mesh->vertices) {
+        return parg_buffer_length(mesh->vertices) / mesh->stride;
+    }
+    parg_vertex_attrib const* attrib = &mesh->layout[PARG_MESH_COORD];
+    int vsize = attrib->ncomps * parg_data_type_size(attrib->type);
+    return parg_buffer_length(mesh->coords) / vsize;
+}
+
+// Packs the separate attribute buffers into a single CPU buffer with one
+// vertex per stride, padding each attribute to a 4-byte boundary.  The
+// separate buffers are freed; use parg_varray_enable_mesh to draw the result.
+void parg_mesh_interleave(parg_mesh* mesh)
+{
+    if (mesh->vertices) {
+        return;
+    }
+    parg_assert(!parg_buffer_gpu_check(mesh->coords), "CPU mesh required");
+    parg_buffer* sources[PARG_MESH_NATTRIBS] = {
+        mesh->coords, mesh->uvs, mesh->normals, mesh->tangents};
+    int sizes[PARG_MESH_NATTRIBS] = {0};
+    int stride = 0;
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        parg_vertex_attrib* attrib = &mesh->layout[a];
+        if (!sources[a]) {
+            attrib->ncomps = 0;
+            continue;
+        }
+        sizes[a] = attrib->ncomps * parg_data_type_size(attrib->type);
+        attrib->offset = stride;
+        stride += (sizes[a] + 3) & ~3;
+    }
+    int nverts = parg_mesh_nverts(mesh);
+    mesh->vertices = parg_buffer_alloc(nverts * stride, PARG_CPU);
+    char* dst = parg_buffer_lock(mesh->vertices, PARG_WRITE);
+    memset(dst, 0, nverts * stride);
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        if (!sources[a]) {
+            continue;
+        }
+        char const* src = parg_buffer_lock(sources[a], PARG_READ);
+        char* pdst = dst + mesh->layout[a].offset;
+        for (int v = 0; v < nverts; v++, pdst += stride, src += sizes[a]) {
+            memcpy(pdst, src, sizes[a]);
+        }
+        parg_buffer_unlock(sources[a]);
+        parg_buffer_free(sources[a]);
+    }
+    parg_buffer_unlock(mesh->vertices);
+    mesh->coords = mesh->uvs = mesh->normals = mesh->tangents = 0;
+    mesh->stride = stride;
+}
+
+typedef kvec_t(parg_mesh*) meshvec;
+
+static parg_buffer* gather_floats(float const* src, int ncomps,
+    uint32_t const* gathered, int nverts)
+{
+    parg_buffer* dst = parg_buffer_alloc(nverts * sizeof(float) * ncomps,
+        PARG_CPU);
+    float* pdst = (float*) parg_buffer_lock(dst, PARG_WRITE);
+    for (int i = 0; i < nverts; i++) {
+        memcpy(pdst + i * ncomps, src + gathered[i] * ncomps,
+            sizeof(float) * ncomps);
+    }
+    parg_buffer_unlock(dst);
+    return dst;
+}
+
+static void flush_split(meshvec* meshes, uint32_t const* gathered, int nverts,
+    uint16_t const* tris, int ntris, float const** sources,
+    parg_vertex_attrib const* layout)
+{
+    parg_mesh* dst = parg_mesh_alloc(3);
+    memcpy(dst->layout, layout, sizeof(dst->layout));
+    parg_buffer* gathers[PARG_MESH_NATTRIBS] = {0};
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        if (sources[a]) {
+            int ncomps = layout[a].ncomps;
+            gathers[a] = gather_floats(sources[a], ncomps, gathered, nverts);
+        }
+    }
+    dst->coords = gathers[PARG_MESH_COORD];
+    dst->uvs = gathers[PARG_MESH_UV];
+    dst->normals = gathers[PARG_MESH_NORMAL];
+    dst->tangents = gathers[PARG_MESH_TANGENT];
+    dst->indices = parg_buffer_create(
+        (void*) tris, ntris * sizeof(uint16_t) * 3, PARG_CPU);
+    dst->indextype = PARG_USHORT;
+    dst->ntriangles = ntris;
+    kv_push(parg_mesh*, *meshes, dst);
+}
+
+// Chunks a CPU-resident mesh into sub-meshes that each reference fewer than
+// 65536 vertices, for targets that lack 32-bit index support (GLES2 and
+// WebGL without OES_element_index_uint).  Triangles are emitted in their
+// original order.  The caller owns the returned meshes and the array itself.
+parg_mesh** parg_mesh_split_u16(parg_mesh* src, int* nmeshes)
+{
+    parg_assert(src->coords, "Non-interleaved mesh required");
+    parg_assert(src->indices, "Indexed mesh required");
+    parg_assert(!parg_buffer_gpu_check(src->coords), "CPU mesh required");
+    parg_buffer* buffers[PARG_MESH_NATTRIBS] = {
+        src->coords, src->uvs, src->normals, src->tangents};
+    float const* sources[PARG_MESH_NATTRIBS] = {0};
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        parg_assert(src->layout[a].type == PARG_FLOAT,
+            "Cannot split a quantized mesh");
+    }
+    const int maxverts = 0xffff;
+    int nverts = parg_mesh_nverts(src);
+    void const* indices = parg_buffer_lock(src->indices, PARG_READ);
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        if (buffers[a]) {
+            sources[a] = parg_buffer_lock(buffers[a], PARG_READ);
+        }
+    }
+
+    // The stamp array records which chunk most recently claimed each vertex,
+    // which avoids clearing the remap table between chunks.
+    int* remap = malloc(nverts * sizeof(int));
+    int* stamp = calloc(nverts, sizeof(int));
+    uint32_t* gathered = malloc(maxverts * sizeof(uint32_t));
+    uint16_t* tris = malloc(src->ntriangles * 3 * sizeof(uint16_t));
+    meshvec meshes;
+    kv_init(meshes);
+
+    int chunk = 1, nlocal = 0, ntris = 0;
+    for (int t = 0; t < src->ntriangles; t++) {
+        uint32_t corners[3];
+        int nnew = 0;
+        for (int c = 0; c < 3; c++) {
+            corners[c] = parg_mesh_index_at(indices, src->indextype, t * 3 + c);
+            nnew += stamp[corners[c]] != chunk;
+        }
+        if (nlocal + nnew > maxverts) {
+            flush_split(&meshes, gathered, nlocal, tris, ntris, sources,
+                src->layout);
+            chunk++;
+            nlocal = ntris = 0;
+        }
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = corners[c];
+            if (stamp[v] != chunk) {
+                stamp[v] = chunk;
+                remap[v] = nlocal;
+                gathered[nlocal++] = v;
+            }
+            tris[ntris * 3 + c] = remap[v];
+        }
+        ntris++;
+    }
+    if (ntris) {
+        flush_split(&meshes, gathered, nlocal, tris, ntris, sources,
+            src->layout);
+    }
+
+    free(remap);
+    free(stamp);
+    free(gathered);
+    free(tris);
+    parg_buffer_unlock(src->indices);
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        if (buffers[a]) {
+            parg_buffer_unlock(buffers[a]);
+        }
     }
+    *nmeshes = kv_size(meshes);
+    return meshes.a;
 }
@@ -0,0 +1,280 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "internal.h"
+#include "kvec.h"
+
+// Meshlets are grown greedily from a seed triangle, always adding the
+// adjacent triangle that introduces the fewest new vertices, until either
+// limit is reached.  The index buffer is then rewritten so that each meshlet
+// is a contiguous range.  Sub-mesh ranges are clustered independently so
+// they remain valid.  Back-face culling uses the normal cone test from
+// meshoptimizer, where a cluster is rejected when every triangle in it faces
+// away from the eye.
+
+typedef struct {
+    int nverts;
+    int* offsets;
+    int* adjacency;
+    char* emitted;
+    int* vmark;
+    uint32_t const* src;
+    uint32_t* dst;
+    int nemitted;
+} meshlet_builder;
+
+typedef kvec_t(parg_meshlet) meshlet_vec;
+
+static void build_adjacency(meshlet_builder* builder, int ntris)
+{
+    int nverts = builder->nverts;
+    int* counts = calloc(nverts, sizeof(int));
+    for (int i = 0; i < ntris * 3; i++) {
+        counts[builder->src[i]]++;
+    }
+    builder->offsets = malloc((nverts + 1) * sizeof(int));
+    builder->offsets[0] = 0;
+    for (int v = 0; v < nverts; v++) {
+        builder->offsets[v + 1] = builder->offsets[v] + counts[v];
+        counts[v] = 0;
+    }
+    builder->adjacency = malloc(ntris * 3 * sizeof(int));
+    for (int i = 0; i < ntris * 3; i++) {
+        uint32_t v = builder->src[i];
+        builder->adjacency[builder->offsets[v] + counts[v]++] = i / 3;
+    }
+    free(counts);
+}
+
+static int count_new_verts(meshlet_builder const* builder, int tri, int id)
+{
+    uint32_t const* corners = builder->src + tri * 3;
+    int n = 0;
+    for (int c = 0; c < 3; c++) {
+        n += builder->vmark[corners[c]] != id;
+    }
+    return n;
+}
+
+// Clusters the triangles in [first, last) and appends the meshlets.
+static void build_range(meshlet_builder* builder, int first, int last,
+    int max_verts, int max_tris, meshlet_vec* meshlets)
+{
+    kvec_t(int) candidates;
+    kv_init(candidates);
+    int cursor = first;
+    while (builder->nemitted < last) {
+        int id = kv_size(*meshlets);
+        parg_meshlet meshlet = {builder->nemitted, 0};
+        int nverts = 0;
+        kv_size(candidates) = 0;
+        while (meshlet.ntriangles < max_tris) {
+
+            // Pick the connected triangle that adds the fewest vertices,
+            // pruning stale candidates along the way.
+            int best = -1, bestcost = 4;
+            for (int i = 0; i < kv_size(candidates) && bestcost > 0;) {
+                int t = kv_A(candidates, i);
+                if (builder->emitted[t]) {
+                    kv_A(candidates, i) = kv_pop(candidates);
+                    continue;
+                }
+                int cost = count_new_verts(builder, t, id);
+                if (cost < bestcost) {
+                    bestcost = cost;
+                    best = t;
+                }
+                i++;
+            }
+
+            // Seed empty clusters with the next triangle in the original
+            // order, and close clusters that have no neighbors left.
+            if (best < 0) {
+                if (meshlet.ntriangles > 0) {
+                    break;
+                }
+                while (cursor < last && builder->emitted[cursor]) {
+                    cursor++;
+                }
+                if (cursor == last) {
+                    break;
+                }
+                best = cursor;
+                bestcost = count_new_verts(builder, best, id);
+            }
+            if (nverts + bestcost > max_verts) {
+                break;
+            }
+            uint32_t const* corners = builder->src + best * 3;
+            memcpy(builder->dst + builder->nemitted * 3, corners,
+                sizeof(uint32_t) * 3);
+            builder->emitted[best] = 1;
+            builder->nemitted++;
+            meshlet.ntriangles++;
+            nverts += bestcost;
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = corners[c];
+                builder->vmark[v] = id;
+                int const* adj = builder->adjacency + builder->offsets[v];
+                int nadj = builder->offsets[v + 1] - builder->offsets[v];
+                for (int j = 0; j < nadj; j++) {
+                    int t = adj[j];
+                    if (!builder->emitted[t] && t >= first && t < last) {
+                        kv_push(int, candidates, t);
+                    }
+                }
+            }
+        }
+        kv_push(parg_meshlet, *meshlets, meshlet);
+    }
+    kv_destroy(candidates);
+}
+
+static void compute_meshlet_bounds(
+    parg_meshlet* meshlet, uint32_t const* indices, Point3 const* coords)
+{
+    Point3 lower = {INFINITY, INFINITY, INFINITY};
+    Point3 upper = {-INFINITY, -INFINITY, -INFINITY};
+    Vector3 normalsum = {0, 0, 0};
+    uint32_t const* tris = indices + meshlet->start * 3;
+    for (int t = 0; t < meshlet->ntriangles; t++) {
+        Point3 a = coords[tris[t * 3]];
+        Point3 b = coords[tris[t * 3 + 1]];
+        Point3 c = coords[tris[t * 3 + 2]];
+        lower = P3MinPerElem(lower, P3MinPerElem(a, P3MinPerElem(b, c)));
+        upper = P3MaxPerElem(upper, P3MaxPerElem(a, P3MaxPerElem(b, c)));
+        Vector3 n = V3Cross(P3Sub(b, a), P3Sub(c, a));
+        float len = V3Length(n);
+        if (len > 0) {
+            normalsum = V3Add(normalsum, V3ScalarMul(n, 1.0f / len));
+        }
+    }
+    Point3 center = P3Lerp(0.5f, lower, upper);
+    float radius2 = 0;
+    for (int i = 0; i < meshlet->ntriangles * 3; i++) {
+        radius2 = PARG_MAX(radius2, P3DistSqr(coords[tris[i]], center));
+    }
+    meshlet->center = center;
+    meshlet->radius = sqrtf(radius2);
+
+    // A cutoff of 1 disables back-face culling for wide or empty cones.
+    float len = V3Length(normalsum);
+    meshlet->coneaxis = len > 0 ? V3ScalarMul(normalsum, 1.0f / len)
+        : normalsum;
+    meshlet->conecutoff = 1;
+    if (len == 0) {
+        return;
+    }
+    float mindot = 1;
+    for (int t = 0; t < meshlet->ntriangles; t++) {
+        Point3 a = coords[tris[t * 3]];
+        Point3 b = coords[tris[t * 3 + 1]];
+        Point3 c = coords[tris[t * 3 + 2]];
+        Vector3 n = V3Cross(P3Sub(b, a), P3Sub(c, a));
+        float nlen = V3Length(n);
+        if (nlen > 0) {
+            mindot = PARG_MIN(mindot, V3Dot(n, meshlet->coneaxis) / nlen);
+        }
+    }
+    if (mindot > 0.1f) {
+        meshlet->conecutoff = sqrtf(1 - mindot * mindot);
+    }
+}
+
+int parg_mesh_build_meshlets(parg_mesh* mesh, int max_verts, int max_tris)
+{
+    parg_vertex_attrib const* attrib = &mesh->layout[PARG_MESH_COORD];
+    parg_assert(max_verts >= 3 && max_tris >= 1, "Bad meshlet limits");
+    parg_assert(mesh->coords && !parg_buffer_gpu_check(mesh->coords),
+        "CPU mesh required");
+    parg_assert(attrib->ncomps == 3 && attrib->type == PARG_FLOAT,
+        "Meshlets require float3 coordinates");
+    int ntris = mesh->ntriangles;
+    uint32_t* src = parg_mesh_read_indices(mesh);
+    meshlet_builder builder = {0};
+    builder.nverts = parg_mesh_nverts(mesh);
+    builder.src = src;
+    builder.dst = malloc(ntris * 3 * sizeof(uint32_t));
+    builder.emitted = calloc(ntris, 1);
+    builder.vmark = malloc(builder.nverts * sizeof(int));
+    memset(builder.vmark, 0xff, builder.nverts * sizeof(int));
+    build_adjacency(&builder, ntris);
+
+    meshlet_vec meshlets;
+    kv_init(meshlets);
+    if (mesh->nsubmeshes) {
+        for (int s = 0; s < mesh->nsubmeshes; s++) {
+            parg_submesh const* submesh = mesh->submeshes + s;
+            int first = submesh->start;
+            parg_assert(first == builder.nemitted,
+                "Sub-meshes must be contiguous");
+            build_range(&builder, first, first + submesh->ntriangles,
+                max_verts, max_tris, &meshlets);
+        }
+    } else {
+        build_range(&builder, 0, ntris, max_verts, max_tris, &meshlets);
+    }
+    free(builder.offsets);
+    free(builder.adjacency);
+    free(builder.emitted);
+    free(builder.vmark);
+    free(src);
+
+    Point3 const* coords = parg_buffer_lock(mesh->coords, PARG_READ);
+    for (int m = 0; m < kv_size(meshlets); m++) {
+        compute_meshlet_bounds(&kv_A(meshlets, m), builder.dst, coords);
+    }
+    parg_buffer_unlock(mesh->coords);
+    parg_mesh_write_indices(mesh, builder.dst, ntris);
+    free(builder.dst);
+    mesh->meshlets = meshlets.a;
+    mesh->nmeshlets = kv_size(meshlets);
+    return mesh->nmeshlets;
+}
+
+int parg_mesh_nmeshlets(parg_mesh* m) { return m->nmeshlets; }
+
+void parg_mesh_meshlet_range(parg_mesh* m, int index, int* start, int* ntris)
+{
+    parg_assert(index >= 0 && index < m->nmeshlets, "Bad meshlet index");
+    *start = m->meshlets[index].start;
+    *ntris = m->meshlets[index].ntriangles;
+}
+
+// The frustum planes are extracted from the rows of the view-projection
+// matrix, as described by Gribb and Hartmann.
+int parg_mesh_cull_meshlets(
+    parg_mesh* m, Matrix4 viewproj, Point3 eyepos, int* visible)
+{
+    Vector4 planes[6];
+    Vector4 w = M4GetRow(viewproj, 3);
+    for (int i = 0; i < 3; i++) {
+        Vector4 row = M4GetRow(viewproj, i);
+        planes[i * 2] = V4Add(w, row);
+        planes[i * 2 + 1] = V4Sub(w, row);
+    }
+    for (int p = 0; p < 6; p++) {
+        float len = V3Length(V4GetXYZ(planes[p]));
+        planes[p] = V4ScalarMul(planes[p], 1.0f / len);
+    }
+    int nvisible = 0;
+    for (int i = 0; i < m->nmeshlets; i++) {
+        parg_meshlet const* meshlet = m->meshlets + i;
+        Vector4 center = V4MakeFromP3(meshlet->center);
+        int inside = 1;
+        for (int p = 0; p < 6 && inside; p++) {
+            inside = V4Dot(planes[p], center) >= -meshlet->radius;
+        }
+        if (!inside) {
+            continue;
+        }
+        Vector3 view = P3Sub(meshlet->center, eyepos);
+        if (V3Dot(view, meshlet->coneaxis) >=
+            meshlet->conecutoff * V3Length(view) + meshlet->radius) {
+            continue;
+        }
+        visible[nvisible++] = i;
+    }
+    return nvisible;
+}
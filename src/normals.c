@@ -0,0 +1,130 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "internal.h"
+
+// Smooth normals are computed in two parallel phases.  First, the triangles
+// are split into one partition per thread and each partition accumulates
+// weighted face normals into its own array, which avoids atomics.  Second,
+// the vertex range is split across threads to sum the partitions and
+// normalize the result directly into the mesh's normal buffer.
+
+#define REDUCE_GRAIN 4096
+
+typedef struct {
+    Vector3 const* coords;
+    void const* indices;
+    parg_data_type indextype;
+    int ntriangles;
+    int nverts;
+    int weighting;
+    int npartitions;
+    Vector3** accum;
+    Vector3* normals;
+} normals_job;
+
+static float corner_angle(Vector3 a, Vector3 b)
+{
+    float la = V3Length(a), lb = V3Length(b);
+    if (la == 0 || lb == 0) {
+        return 0;
+    }
+    float cosine = V3Dot(a, b) / (la * lb);
+    return acosf(PARG_CLAMP(cosine, -1.0f, 1.0f));
+}
+
+static void accumulate(int begin, int end, void* userdata)
+{
+    normals_job const* job = userdata;
+    for (int p = begin; p < end; p++) {
+        Vector3* accum = calloc(job->nverts, sizeof(Vector3));
+        int first = (long) job->ntriangles * p / job->npartitions;
+        int last = (long) job->ntriangles * (p + 1) / job->npartitions;
+        for (int t = first; t < last; t++) {
+            uint32_t tri[3];
+            Vector3 pts[3];
+            for (int c = 0; c < 3; c++) {
+                tri[c] = parg_mesh_index_at(
+                    job->indices, job->indextype, t * 3 + c);
+                pts[c] = job->coords[tri[c]];
+            }
+            Vector3 e01 = V3Sub(pts[1], pts[0]);
+            Vector3 e12 = V3Sub(pts[2], pts[1]);
+            Vector3 e20 = V3Sub(pts[0], pts[2]);
+
+            // The length of the cross product is twice the triangle area.
+            Vector3 facet = V3Cross(e01, V3Neg(e20));
+            if (job->weighting == PARG_WEIGHT_AREA) {
+                for (int c = 0; c < 3; c++) {
+                    accum[tri[c]] = V3Add(accum[tri[c]], facet);
+                }
+                continue;
+            }
+            float len = V3Length(facet);
+            if (len == 0) {
+                continue;
+            }
+            facet = V3ScalarMul(facet, 1.0f / len);
+            float angles[3] = {corner_angle(e01, V3Neg(e20)),
+                corner_angle(e12, V3Neg(e01)),
+                corner_angle(e20, V3Neg(e12))};
+            for (int c = 0; c < 3; c++) {
+                accum[tri[c]] =
+                    V3Add(accum[tri[c]], V3ScalarMul(facet, angles[c]));
+            }
+        }
+        job->accum[p] = accum;
+    }
+}
+
+static void reduce(int begin, int end, void* userdata)
+{
+    normals_job const* job = userdata;
+    for (int v = begin; v < end; v++) {
+        Vector3 sum = job->accum[0][v];
+        for (int p = 1; p < job->npartitions; p++) {
+            sum = V3Add(sum, job->accum[p][v]);
+        }
+        float len = V3Length(sum);
+        job->normals[v] = len > 0 ? V3ScalarMul(sum, 1.0f / len) : sum;
+    }
+}
+
+void parg_mesh_compute_normals_weighted(parg_mesh* mesh, int weighting)
+{
+    parg_vertex_attrib const* attrib = &mesh->layout[PARG_MESH_COORD];
+    parg_assert(mesh->coords && !parg_buffer_gpu_check(mesh->coords),
+        "CPU mesh required");
+    parg_assert(attrib->ncomps == 3 && attrib->type == PARG_FLOAT,
+        "Normals require float3 coordinates");
+    normals_job job = {0};
+    job.nverts = parg_mesh_nverts(mesh);
+    job.ntriangles = mesh->ntriangles;
+    job.indextype = mesh->indextype;
+    job.weighting = weighting;
+    job.npartitions = PARG_MAX(1, PARG_MIN(parg_thread_count(),
+        job.ntriangles / REDUCE_GRAIN));
+    job.accum = malloc(sizeof(Vector3*) * job.npartitions);
+    job.coords = parg_buffer_lock(mesh->coords, PARG_READ);
+    job.indices = parg_buffer_lock(mesh->indices, PARG_READ);
+    parg_parallel_for(job.npartitions, 1, accumulate, &job);
+    parg_buffer_unlock(mesh->indices);
+    parg_buffer_unlock(mesh->coords);
+
+    parg_buffer_free(mesh->normals);
+    mesh->normals = parg_buffer_alloc(job.nverts * sizeof(Vector3), PARG_CPU);
+    mesh->layout[PARG_MESH_NORMAL] = (parg_vertex_attrib){3, PARG_FLOAT, 0, 0};
+    job.normals = parg_buffer_lock(mesh->normals, PARG_WRITE);
+    parg_parallel_for(job.nverts, REDUCE_GRAIN, reduce, &job);
+    parg_buffer_unlock(mesh->normals);
+    for (int p = 0; p < job.npartitions; p++) {
+        free(job.accum[p]);
+    }
+    free(job.accum);
+}
+
+void parg_mesh_compute_normals(parg_mesh* mesh)
+{
+    parg_mesh_compute_normals_weighted(mesh, PARG_WEIGHT_AREA);
+}
@@ -0,0 +1,517 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "internal.h"
+#include "kvec.h"
+#include "khash.h"
+
+// In-place OBJ parser.  The text is split into line-aligned chunks that are
+// processed in parallel, in two passes: the first counts the vertex records
+// in each chunk so that every chunk knows where its positions, uvs and
+// normals land in the global arrays, and the second parses them directly
+// into place.  Faces are triangulated as fans, relative indices are resolved
+// against the global counts, and "o" and "g" records start new sub-meshes.
+// Finally, the position / uv / normal triplets are deduplicated into unique
+// vertices.  Materials, smoothing groups and free-form geometry are ignored.
+
+#define MIN_CHUNK_SIZE (256 * 1024)
+#define CHUNKS_PER_THREAD 4
+
+typedef struct {
+    int triangle;
+    char const* name;
+    int len;
+} obj_group;
+
+typedef kvec_t(int) intvec;
+
+typedef struct {
+    char const* begin;
+    char const* end;
+    int npositions;
+    int nuvs;
+    int nnormals;
+    int firstposition;
+    int firstuv;
+    int firstnormal;
+    intvec corners;
+    kvec_t(obj_group) groups;
+} obj_chunk;
+
+typedef struct {
+    obj_chunk* chunks;
+    float* positions;
+    float* uvs;
+    float* normals;
+} obj_parser;
+
+typedef struct {
+    int chunk;
+    int first;
+    int count;
+    int submesh;
+} obj_span;
+
+KHASH_MAP_INIT_INT(submeshes, int)
+
+static int is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static int is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static char const* skip_space(char const* p, char const* end)
+{
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// Accumulates up to 19 significant digits in an integer and then scales by
+// an exact power of ten, which is both much faster than strtod and exact for
+// the short decimals that exporters write.
+static char const* parse_float(char const* p, char const* end, float* result)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+        1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+        1e20, 1e21, 1e22};
+    p = skip_space(p, end);
+    int negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int ndigits = 0, exponent = 0;
+    for (; p < end && is_digit(*p); p++) {
+        if (ndigits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            ndigits += mantissa > 0;
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && is_digit(*p); p++) {
+            if (ndigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                ndigits += mantissa > 0;
+                exponent--;
+            }
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int expsign = 1, expvalue = 0;
+        if (p < end && (*p == '-' || *p == '+')) {
+            expsign = *p++ == '-' ? -1 : 1;
+        }
+        for (; p < end && is_digit(*p); p++) {
+            expvalue = PARG_MIN(expvalue * 10 + (*p - '0'), 10000);
+        }
+        exponent += expsign * expvalue;
+    }
+    double value = mantissa;
+    if (exponent < 0) {
+        value = -exponent <= 22 ? value / powers[-exponent]
+            : value * pow(10, exponent);
+    } else if (exponent > 0) {
+        value = exponent <= 22 ? value * powers[exponent]
+            : value * pow(10, exponent);
+    }
+    *result = negative ? -value : value;
+    return p;
+}
+
+// Parses a 1-based or negative relative index, returning a 0-based index or
+// -1 if the field is empty.
+static char const* parse_index(
+    char const* p, char const* end, int count, int* result)
+{
+    int negative = p < end && *p == '-';
+    if (negative) {
+        p++;
+    }
+    int value = 0, ndigits = 0;
+    for (; p < end && is_digit(*p); p++, ndigits++) {
+        value = value * 10 + (*p - '0');
+    }
+    *result = ndigits == 0 ? -1 : negative ? count - value : value - 1;
+    return p;
+}
+
+static char const* line_end(char const* p, char const* end)
+{
+    char const* newline = memchr(p, '\n', end - p);
+    return newline ? newline : end;
+}
+
+static void count_records(int begin, int end, void* userdata)
+{
+    obj_parser* parser = userdata;
+    for (int c = begin; c < end; c++) {
+        obj_chunk* chunk = parser->chunks + c;
+        char const* p = chunk->begin;
+        while (p < chunk->end) {
+            char const* eol = line_end(p, chunk->end);
+            p = skip_space(p, eol);
+            if (eol - p >= 2 && p[0] == 'v') {
+                chunk->npositions += is_space(p[1]);
+                chunk->nuvs += p[1] == 't';
+                chunk->nnormals += p[1] == 'n';
+            }
+            p = eol + 1;
+        }
+    }
+}
+
+static void parse_face(obj_chunk* chunk, char const* p, char const* end,
+    int npositions, int nuvs, int nnormals)
+{
+    int first[3] = {0}, prev[3] = {0}, ncorners = 0;
+    while ((p = skip_space(p, end)) < end) {
+        int corner[3];
+        p = parse_index(p, end, npositions, &corner[0]);
+        corner[1] = corner[2] = -1;
+        if (p < end && *p == '/') {
+            p = parse_index(p + 1, end, nuvs, &corner[1]);
+            if (p < end && *p == '/') {
+                p = parse_index(p + 1, end, nnormals, &corner[2]);
+            }
+        }
+        while (p < end && !is_space(*p)) {
+            p++;
+        }
+        if (corner[0] < 0) {
+            continue;
+        }
+        if (ncorners == 0) {
+            memcpy(first, corner, sizeof(first));
+        } else if (ncorners >= 2) {
+            for (int k = 0; k < 3; k++) {
+                kv_push(int, chunk->corners, first[k]);
+            }
+            for (int k = 0; k < 3; k++) {
+                kv_push(int, chunk->corners, prev[k]);
+            }
+            for (int k = 0; k < 3; k++) {
+                kv_push(int, chunk->corners, corner[k]);
+            }
+        }
+        memcpy(prev, corner, sizeof(prev));
+        ncorners++;
+    }
+}
+
+static void parse_records(int begin, int end, void* userdata)
+{
+    obj_parser* parser = userdata;
+    for (int c = begin; c < end; c++) {
+        obj_chunk* chunk = parser->chunks + c;
+        int npositions = chunk->firstposition;
+        int nuvs = chunk->firstuv;
+        int nnormals = chunk->firstnormal;
+        char const* p = chunk->begin;
+        while (p < chunk->end) {
+            char const* eol = line_end(p, chunk->end);
+            p = skip_space(p, eol);
+            if (eol - p < 2) {
+                p = eol + 1;
+                continue;
+            }
+            if (p[0] == 'v' && is_space(p[1])) {
+                float* dst = parser->positions + npositions++ * 3;
+                p = parse_float(p + 1, eol, dst);
+                p = parse_float(p, eol, dst + 1);
+                parse_float(p, eol, dst + 2);
+            } else if (p[0] == 'v' && p[1] == 't') {
+                float* dst = parser->uvs + nuvs++ * 2;
+                p = parse_float(p + 2, eol, dst);
+                parse_float(p, eol, dst + 1);
+            } else if (p[0] == 'v' && p[1] == 'n') {
+                float* dst = parser->normals + nnormals++ * 3;
+                p = parse_float(p + 2, eol, dst);
+                p = parse_float(p, eol, dst + 1);
+                parse_float(p, eol, dst + 2);
+            } else if (p[0] == 'f' && is_space(p[1])) {
+                parse_face(chunk, p + 1, eol, npositions, nuvs, nnormals);
+            } else if ((p[0] == 'g' || p[0] == 'o') && is_space(p[1])) {
+                char const* name = skip_space(p + 1, eol);
+                char const* nameend = eol;
+                while (nameend > name && is_space(nameend[-1])) {
+                    nameend--;
+                }
+                obj_group group = {kv_size(chunk->corners) / 9, name,
+                    nameend - name};
+                kv_push(obj_group, chunk->groups, group);
+            }
+            p = eol + 1;
+        }
+    }
+}
+
+static int chunk_count(int nbytes)
+{
+    int nchunks = parg_thread_count() * CHUNKS_PER_THREAD;
+    return PARG_MAX(1, PARG_MIN(nchunks, nbytes / MIN_CHUNK_SIZE));
+}
+
+static obj_chunk* split_chunks(char const* text, int nbytes, int nchunks)
+{
+    obj_chunk* chunks = calloc(nchunks, sizeof(obj_chunk));
+    char const* end = text + nbytes;
+    char const* p = text;
+    for (int c = 0; c < nchunks; c++) {
+        chunks[c].begin = p;
+        if (c < nchunks - 1) {
+            char const* split = text + (long) nbytes * (c + 1) / nchunks;
+            p = PARG_MAX(p, split);
+            p = p < end ? line_end(p, end) + 1 : end;
+            p = PARG_MIN(p, end);
+        } else {
+            p = end;
+        }
+        chunks[c].end = p;
+    }
+    return chunks;
+}
+
+static parg_token group_token(obj_group const* group)
+{
+    if (group->len == 0) {
+        return 0;
+    }
+    sds name = sdsnewlen(group->name, group->len);
+    parg_token token = parg_token_from_string(name);
+    sdsfree(name);
+    return token;
+}
+
+typedef kvec_t(parg_submesh) submeshvec;
+
+static int find_submesh(
+    khash_t(submeshes)* lookup, submeshvec* submeshes, parg_token name)
+{
+    int ret;
+    khiter_t iter = kh_put(submeshes, lookup, name, &ret);
+    if (ret) {
+        parg_submesh submesh = {0, 0, name};
+        kh_value(lookup, iter) = kv_size(*submeshes);
+        kv_push(parg_submesh, *submeshes, submesh);
+    }
+    return kh_value(lookup, iter);
+}
+
+// Sorts triangles so that each sub-mesh occupies a contiguous range, in order
+// of first appearance, and returns the corner triplets in that order.
+static int* gather_submeshes(parg_mesh* dst, obj_chunk* chunks, int nchunks,
+    int ntriangles)
+{
+    khash_t(submeshes)* lookup = kh_init(submeshes);
+    kvec_t(obj_span) spans;
+    submeshvec submeshes;
+    kv_init(spans);
+    kv_init(submeshes);
+    int current = -1;
+    for (int c = 0; c < nchunks; c++) {
+        obj_chunk* chunk = chunks + c;
+        int ntris = kv_size(chunk->corners) / 9;
+        int ngroups = kv_size(chunk->groups);
+        for (int g = -1; g < ngroups; g++) {
+            if (g >= 0) {
+                parg_token name = group_token(&kv_A(chunk->groups, g));
+                current = find_submesh(lookup, &submeshes, name);
+            }
+            int first = g >= 0 ? kv_A(chunk->groups, g).triangle : 0;
+            int last = g + 1 < ngroups ? kv_A(chunk->groups, g + 1).triangle
+                : ntris;
+            if (last == first) {
+                continue;
+            }
+            if (current < 0) {
+                current = find_submesh(lookup, &submeshes, 0);
+            }
+            obj_span span = {c, first, last - first, current};
+            kv_push(obj_span, spans, span);
+            kv_A(submeshes, current).ntriangles += last - first;
+        }
+    }
+    kh_destroy(submeshes, lookup);
+
+    int start = 0;
+    for (int s = 0; s < kv_size(submeshes); s++) {
+        parg_submesh* submesh = &kv_A(submeshes, s);
+        submesh->start = start;
+        start += submesh->ntriangles;
+    }
+    int* cursor = malloc(sizeof(int) * (kv_size(submeshes) + 1));
+    for (int s = 0; s < kv_size(submeshes); s++) {
+        cursor[s] = kv_A(submeshes, s).start;
+    }
+    int* corners = malloc(sizeof(int) * ntriangles * 9);
+    for (int i = 0; i < kv_size(spans); i++) {
+        obj_span const* span = &kv_A(spans, i);
+        memcpy(corners + cursor[span->submesh] * 9,
+            chunks[span->chunk].corners.a + span->first * 9,
+            sizeof(int) * span->count * 9);
+        cursor[span->submesh] += span->count;
+    }
+    free(cursor);
+    kv_destroy(spans);
+
+    // Groups that never received any faces are dropped.
+    int nsubmeshes = 0;
+    for (int s = 0; s < kv_size(submeshes); s++) {
+        if (kv_A(submeshes, s).ntriangles > 0) {
+            kv_A(submeshes, nsubmeshes++) = kv_A(submeshes, s);
+        }
+    }
+    dst->submeshes = submeshes.a;
+    dst->nsubmeshes = nsubmeshes;
+    return corners;
+}
+
+static uint32_t hash_corner(int const* corner)
+{
+    return (uint32_t) corner[0] * 73856093u ^ (uint32_t) corner[1] *
+        19349663u ^ (uint32_t) corner[2] * 83492791u;
+}
+
+// Assigns a vertex to each unique (position, uv, normal) triplet using an
+// open-addressing hash table, overwriting each triplet's position index with
+// the vertex index.  Returns the number of unique vertices, whose triplets
+// are written to "unique".
+static int dedup_corners(int* corners, int ncorners, int* unique)
+{
+    int capacity = 1;
+    while (capacity < ncorners * 2) {
+        capacity *= 2;
+    }
+    int* table = malloc(sizeof(int) * capacity);
+    memset(table, 0xff, sizeof(int) * capacity);
+    int nverts = 0;
+    for (int i = 0; i < ncorners; i++) {
+        int* corner = corners + i * 3;
+        uint32_t slot = hash_corner(corner) & (capacity - 1);
+        while (table[slot] >= 0 &&
+            memcmp(unique + table[slot] * 3, corner, sizeof(int) * 3)) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] < 0) {
+            table[slot] = nverts;
+            memcpy(unique + nverts++ * 3, corner, sizeof(int) * 3);
+        }
+        corner[0] = table[slot];
+    }
+    free(table);
+    return nverts;
+}
+
+static parg_buffer* gather_attribute(float const* src, int nsrc, int ncomps,
+    int const* unique, int field, int nverts)
+{
+    parg_buffer* dst = parg_buffer_alloc(nverts * ncomps * sizeof(float),
+        PARG_CPU);
+    float* pdst = parg_buffer_lock(dst, PARG_WRITE);
+    for (int v = 0; v < nverts; v++, pdst += ncomps) {
+        int index = unique[v * 3 + field];
+        parg_assert(index < nsrc, "OBJ index out of range");
+        if (index < 0) {
+            memset(pdst, 0, sizeof(float) * ncomps);
+        } else {
+            memcpy(pdst, src + index * ncomps, sizeof(float) * ncomps);
+        }
+    }
+    parg_buffer_unlock(dst);
+    return dst;
+}
+
+void parg_load_obj(parg_mesh* dst, parg_buffer* buffer)
+{
+    char const* text = parg_buffer_lock(buffer, PARG_READ);
+    int nbytes = parg_buffer_length(buffer);
+    nbytes = strnlen(text, nbytes);
+    int nchunks = chunk_count(nbytes);
+    obj_parser parser = {split_chunks(text, nbytes, nchunks)};
+    parg_parallel_for(nchunks, 1, count_records, &parser);
+
+    int npositions = 0, nuvs = 0, nnormals = 0;
+    for (int c = 0; c < nchunks; c++) {
+        obj_chunk* chunk = parser.chunks + c;
+        chunk->firstposition = npositions;
+        chunk->firstuv = nuvs;
+        chunk->firstnormal = nnormals;
+        npositions += chunk->npositions;
+        nuvs += chunk->nuvs;
+        nnormals += chunk->nnormals;
+    }
+    parser.positions = malloc(sizeof(float) * 3 * npositions);
+    parser.uvs = malloc(sizeof(float) * 2 * nuvs);
+    parser.normals = malloc(sizeof(float) * 3 * nnormals);
+    parg_parallel_for(nchunks, 1, parse_records, &parser);
+    parg_buffer_unlock(buffer);
+
+    int ntriangles = 0;
+    for (int c = 0; c < nchunks; c++) {
+        ntriangles += kv_size(parser.chunks[c].corners) / 9;
+    }
+    int* corners = gather_submeshes(dst, parser.chunks, nchunks, ntriangles);
+    for (int c = 0; c < nchunks; c++) {
+        kv_destroy(parser.chunks[c].corners);
+        kv_destroy(parser.chunks[c].groups);
+    }
+    free(parser.chunks);
+
+    // If no face refers to a uv or normal, positions map directly to
+    // vertices and deduplication is unnecessary.
+    int ncorners = ntriangles * 3;
+    int hasuvs = 0, hasnormals = 0;
+    for (int i = 0; i < ncorners; i++) {
+        hasuvs |= corners[i * 3 + 1] >= 0;
+        hasnormals |= corners[i * 3 + 2] >= 0;
+    }
+    int nverts;
+    int* unique = 0;
+    if (hasuvs || hasnormals) {
+        unique = malloc(sizeof(int) * 3 * ncorners);
+        nverts = dedup_corners(corners, ncorners, unique);
+    } else {
+        nverts = npositions;
+        for (int i = 0; i < ncorners; i++) {
+            parg_assert(corners[i * 3] < npositions, "OBJ index out of range");
+        }
+        dst->coords = parg_buffer_create(
+            parser.positions, sizeof(float) * 3 * npositions, PARG_CPU);
+    }
+    if (unique) {
+        dst->coords = gather_attribute(
+            parser.positions, npositions, 3, unique, 0, nverts);
+    }
+    if (hasuvs) {
+        dst->uvs = gather_attribute(parser.uvs, nuvs, 2, unique, 1, nverts);
+    }
+    if (hasnormals) {
+        dst->normals = gather_attribute(
+            parser.normals, nnormals, 3, unique, 2, nverts);
+    }
+    free(unique);
+    free(parser.positions);
+    free(parser.uvs);
+    free(parser.normals);
+
+    // 32-bit indices are used only when 16 bits are not enough.
+    dst->indextype = nverts > 0xffff ? PARG_UINT : PARG_USHORT;
+    int isize = parg_data_type_size(dst->indextype);
+    dst->indices = parg_buffer_alloc(ncorners * isize, PARG_CPU);
+    void* pindices = parg_buffer_lock(dst->indices, PARG_WRITE);
+    for (int i = 0; i < ncorners; i++) {
+        if (dst->indextype == PARG_UINT) {
+            ((uint32_t*) pindices)[i] = corners[i * 3];
+        } else {
+            ((uint16_t*) pindices)[i] = corners[i * 3];
+        }
+    }
+    parg_buffer_unlock(dst->indices);
+    dst->ntriangles = ntriangles;
+    free(corners);
+    parg_mesh_compute_submesh_bounds(dst);
+}
@@ -0,0 +1,391 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "internal.h"
+
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" tuned for a 32-entry
+// LRU cache, followed by the clustered overdraw sort from Sander et al, "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw".
+
+#define FORSYTH_CACHE_SIZE 32
+#define FIFO_CACHE_SIZE 16
+
+static float forsyth_score(int cachepos, int livetris)
+{
+    if (livetris == 0) {
+        return -1;
+    }
+    float score = 0;
+    if (cachepos >= 0) {
+        if (cachepos < 3) {
+            score = 0.75f;
+        } else {
+            float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = powf(1.0f - (cachepos - 3) * scale, 1.5f);
+        }
+    }
+    return score + 2.0f / sqrtf(livetris);
+}
+
+static void optimize_vcache(uint32_t* dst, uint32_t const* src, int ntris,
+    int nverts)
+{
+    int* livecount = calloc(nverts, sizeof(int));
+    int* offsets = malloc((nverts + 1) * sizeof(int));
+    int* adjacency = malloc(ntris * 3 * sizeof(int));
+    float* vscore = malloc(nverts * sizeof(float));
+    float* tscore = malloc(ntris * sizeof(float));
+    char* emitted = calloc(ntris, 1);
+
+    // Build a compressed list of triangles for each vertex.
+    for (int i = 0; i < ntris * 3; i++) {
+        livecount[src[i]]++;
+    }
+    offsets[0] = 0;
+    for (int v = 0; v < nverts; v++) {
+        offsets[v + 1] = offsets[v] + livecount[v];
+        livecount[v] = 0;
+    }
+    for (int i = 0; i < ntris * 3; i++) {
+        uint32_t v = src[i];
+        adjacency[offsets[v] + livecount[v]++] = i / 3;
+    }
+    for (int v = 0; v < nverts; v++) {
+        vscore[v] = forsyth_score(-1, livecount[v]);
+    }
+    for (int t = 0; t < ntris; t++) {
+        uint32_t const* tri = src + t * 3;
+        tscore[t] = vscore[tri[0]] + vscore[tri[1]] + vscore[tri[2]];
+    }
+
+    int cache[FORSYTH_CACHE_SIZE + 3];
+    int cachesize = 0;
+    int cursor = 0;
+    int best = -1;
+    for (int n = 0; n < ntris; n++) {
+
+        // When nothing in the cache is adjacent to a live triangle, fall back
+        // to the next triangle in the original order.
+        if (best < 0) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+        uint32_t const* tri = src + best * 3;
+        memcpy(dst + n * 3, tri, sizeof(uint32_t) * 3);
+        emitted[best] = 1;
+
+        // Remove the triangle from the adjacency of its vertices.
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = tri[c];
+            int* list = adjacency + offsets[v];
+            for (int i = 0; i < livecount[v]; i++) {
+                if (list[i] == best) {
+                    list[i] = list[--livecount[v]];
+                    break;
+                }
+            }
+        }
+
+        // Push the triangle's vertices to the front of the LRU cache.
+        int newcache[FORSYTH_CACHE_SIZE + 3];
+        int newsize = 0;
+        for (int c = 0; c < 3; c++) {
+            newcache[newsize++] = tri[c];
+        }
+        for (int i = 0; i < cachesize; i++) {
+            int v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                newcache[newsize++] = v;
+            }
+        }
+        for (int i = FORSYTH_CACHE_SIZE; i < newsize; i++) {
+            vscore[newcache[i]] = forsyth_score(-1, livecount[newcache[i]]);
+        }
+        cachesize = PARG_MIN(newsize, FORSYTH_CACHE_SIZE);
+        memcpy(cache, newcache, cachesize * sizeof(int));
+        for (int i = 0; i < cachesize; i++) {
+            vscore[cache[i]] = forsyth_score(i, livecount[cache[i]]);
+        }
+
+        // Rescore triangles that touch the cache and pick the best one.
+        best = -1;
+        float bestscore = -1;
+        for (int i = 0; i < newsize; i++) {
+            int v = newcache[i];
+            int* list = adjacency + offsets[v];
+            for (int j = 0; j < livecount[v]; j++) {
+                int t = list[j];
+                uint32_t const* adj = src + t * 3;
+                tscore[t] = vscore[adj[0]] + vscore[adj[1]] + vscore[adj[2]];
+                if (i < cachesize && tscore[t] > bestscore) {
+                    bestscore = tscore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    free(livecount);
+    free(offsets);
+    free(adjacency);
+    free(vscore);
+    free(tscore);
+    free(emitted);
+}
+
+typedef struct {
+    int start;
+    int ntris;
+    float sortkey;
+} cluster;
+
+static int cluster_cmp(const void* a, const void* b)
+{
+    cluster const* ca = a;
+    cluster const* cb = b;
+    if (ca->sortkey != cb->sortkey) {
+        return ca->sortkey < cb->sortkey ? 1 : -1;
+    }
+    return ca->start - cb->start;
+}
+
+static void optimize_overdraw(uint32_t* dst, uint32_t const* src, int ntris,
+    int nverts, float const* coords)
+{
+    // Split the triangle sequence wherever a FIFO cache simulation would miss
+    // on all three corners, since reordering at these points is free.
+    int* timestamps = calloc(nverts, sizeof(int));
+    cluster* clusters = malloc(ntris * sizeof(cluster));
+    int nclusters = 0;
+    int clock = FIFO_CACHE_SIZE + 1;
+    for (int t = 0; t < ntris; t++) {
+        int misses = 0;
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = src[t * 3 + c];
+            if (clock - timestamps[v] > FIFO_CACHE_SIZE) {
+                timestamps[v] = clock++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusters[nclusters++] = (cluster){t, 0, 0};
+        }
+        clusters[nclusters - 1].ntris++;
+    }
+    free(timestamps);
+
+    // Sort clusters so that the ones facing away from the mesh centroid are
+    // drawn first, which tends to occlude the interior clusters.
+    Vector3 meshcenter = {0, 0, 0};
+    for (int v = 0; v < nverts; v++) {
+        meshcenter = V3Add(meshcenter, *((Vector3 const*) coords + v));
+    }
+    meshcenter = V3ScalarMul(meshcenter, 1.0f / PARG_MAX(nverts, 1));
+    for (int i = 0; i < nclusters; i++) {
+        Vector3 center = {0, 0, 0};
+        Vector3 normal = {0, 0, 0};
+        float area = 0;
+        uint32_t const* tri = src + clusters[i].start * 3;
+        for (int t = 0; t < clusters[i].ntris; t++, tri += 3) {
+            Vector3 a = *((Vector3 const*) coords + tri[0]);
+            Vector3 b = *((Vector3 const*) coords + tri[1]);
+            Vector3 c = *((Vector3 const*) coords + tri[2]);
+            Vector3 n = V3Cross(V3Sub(b, a), V3Sub(c, a));
+            float twicearea = V3Length(n);
+            Vector3 centroid = V3ScalarMul(V3Add(V3Add(a, b), c), 1.0f / 3);
+            center = V3Add(center, V3ScalarMul(centroid, twicearea));
+            normal = V3Add(normal, n);
+            area += twicearea;
+        }
+        if (area > 0) {
+            center = V3ScalarMul(center, 1.0f / area);
+        }
+        float nlength = V3Length(normal);
+        if (nlength > 0) {
+            normal = V3ScalarMul(normal, 1.0f / nlength);
+        }
+        clusters[i].sortkey = V3Dot(V3Sub(center, meshcenter), normal);
+    }
+    qsort(clusters, nclusters, sizeof(cluster), cluster_cmp);
+    for (int i = 0; i < nclusters; i++) {
+        int nbytes = clusters[i].ntris * 3 * sizeof(uint32_t);
+        memcpy(dst, src + clusters[i].start * 3, nbytes);
+        dst += clusters[i].ntris * 3;
+    }
+    free(clusters);
+}
+
+static parg_buffer* remap_attribute(
+    parg_buffer* src, int nverts, int const* remap, int newcount)
+{
+    if (!src) {
+        return 0;
+    }
+    int stride = parg_buffer_length(src) / nverts;
+    parg_buffer* dst = parg_buffer_alloc(newcount * stride, PARG_CPU);
+    char const* psrc = parg_buffer_lock(src, PARG_READ);
+    char* pdst = parg_buffer_lock(dst, PARG_WRITE);
+    for (int v = 0; v < nverts; v++) {
+        if (remap[v] >= 0) {
+            memcpy(pdst + remap[v] * stride, psrc + v * stride, stride);
+        }
+    }
+    parg_buffer_unlock(dst);
+    parg_buffer_unlock(src);
+    parg_buffer_free(src);
+    return dst;
+}
+
+// Moves each vertex to its slot in the remap table, dropping vertices whose
+// slot is negative.  The index buffer is left untouched.
+void parg_mesh_remap_vertices(
+    parg_mesh* mesh, int nverts, int const* remap, int newcount)
+{
+    mesh->coords = remap_attribute(mesh->coords, nverts, remap, newcount);
+    mesh->uvs = remap_attribute(mesh->uvs, nverts, remap, newcount);
+    mesh->normals = remap_attribute(mesh->normals, nverts, remap, newcount);
+    mesh->tangents = remap_attribute(mesh->tangents, nverts, remap, newcount);
+}
+
+static int optimize_vfetch(uint32_t* indices, int nindices, int nverts,
+    parg_mesh* mesh)
+{
+    int* remap = malloc(nverts * sizeof(int));
+    memset(remap, 0xff, nverts * sizeof(int));
+    int newcount = 0;
+    for (int i = 0; i < nindices; i++) {
+        uint32_t v = indices[i];
+        if (remap[v] < 0) {
+            remap[v] = newcount++;
+        }
+        indices[i] = remap[v];
+    }
+    parg_mesh_remap_vertices(mesh, nverts, remap, newcount);
+    free(remap);
+    return newcount;
+}
+
+uint32_t* parg_mesh_read_indices(parg_mesh* mesh)
+{
+    int nindices = mesh->ntriangles * 3;
+    uint32_t* dst = malloc(nindices * sizeof(uint32_t));
+    void const* src = parg_buffer_lock(mesh->indices, PARG_READ);
+    for (int i = 0; i < nindices; i++) {
+        dst[i] = parg_mesh_index_at(src, mesh->indextype, i);
+    }
+    parg_buffer_unlock(mesh->indices);
+    return dst;
+}
+
+void parg_mesh_write_indices(parg_mesh* mesh, uint32_t const* src, int ntris)
+{
+    int size = mesh->indextype == PARG_UINT ? 4 : 2;
+    parg_buffer_free(mesh->indices);
+    mesh->indices = parg_buffer_alloc(ntris * 3 * size, PARG_CPU);
+    void* dst = parg_buffer_lock(mesh->indices, PARG_WRITE);
+    if (size == 4) {
+        memcpy(dst, src, ntris * 3 * size);
+    } else {
+        uint16_t* pdst = dst;
+        for (int i = 0; i < ntris * 3; i++) {
+            pdst[i] = src[i];
+        }
+    }
+    parg_buffer_unlock(mesh->indices);
+    parg_mesh_indices_changed(mesh, ntris);
+}
+
+// Drops everything derived from the index buffer.  Sub-mesh ranges survive
+// reordering within each range, but not a change in the number of triangles.
+void parg_mesh_indices_changed(parg_mesh* mesh, int ntris)
+{
+    if (ntris != mesh->ntriangles) {
+        free(mesh->submeshes);
+        mesh->submeshes = 0;
+        mesh->nsubmeshes = 0;
+    }
+    mesh->ntriangles = ntris;
+    parg_bvh_free(mesh->bvh);
+    mesh->bvh = 0;
+    free(mesh->meshlets);
+    mesh->meshlets = 0;
+    mesh->nmeshlets = 0;
+    free(mesh->lods);
+    mesh->lods = 0;
+    mesh->nlods = 0;
+}
+
+float parg_mesh_acmr(parg_mesh* mesh)
+{
+    if (mesh->ntriangles == 0) {
+        return 0;
+    }
+    parg_assert(!parg_buffer_gpu_check(mesh->indices), "CPU mesh required");
+    int nverts = parg_mesh_nverts(mesh);
+    int* timestamps = calloc(nverts, sizeof(int));
+    void const* indices = parg_buffer_lock(mesh->indices, PARG_READ);
+    int clock = FIFO_CACHE_SIZE + 1;
+    int misses = 0;
+    for (int i = 0; i < mesh->ntriangles * 3; i++) {
+        uint32_t v = parg_mesh_index_at(indices, mesh->indextype, i);
+        if (clock - timestamps[v] > FIFO_CACHE_SIZE) {
+            timestamps[v] = clock++;
+            misses++;
+        }
+    }
+    parg_buffer_unlock(mesh->indices);
+    free(timestamps);
+    return (float) misses / mesh->ntriangles;
+}
+
+void parg_mesh_optimize(parg_mesh* mesh, int flags)
+{
+    parg_assert(mesh->coords, "Non-interleaved mesh required");
+    parg_assert(!parg_buffer_gpu_check(mesh->coords), "CPU mesh required");
+    int ntris = mesh->ntriangles;
+    int nverts = parg_mesh_nverts(mesh);
+    uint32_t* indices = parg_mesh_read_indices(mesh);
+    uint32_t* scratch = malloc(ntris * 3 * sizeof(uint32_t));
+
+    // Triangles are only reordered within each sub-mesh, and any that are
+    // not covered by a sub-mesh keep their place.
+    memcpy(scratch, indices, ntris * 3 * sizeof(uint32_t));
+    parg_submesh whole = {0, ntris};
+    parg_submesh const* ranges = mesh->nsubmeshes ? mesh->submeshes : &whole;
+    int nranges = PARG_MAX(mesh->nsubmeshes, 1);
+    for (int r = 0; r < nranges; r++) {
+        parg_assert(ranges[r].start >= 0 &&
+                ranges[r].start + ranges[r].ntriangles <= ntris,
+            "Sub-mesh out of range");
+    }
+    if (flags & PARG_OPTIMIZE_VCACHE) {
+        for (int r = 0; r < nranges; r++) {
+            int first = ranges[r].start * 3;
+            optimize_vcache(scratch + first, indices + first,
+                ranges[r].ntriangles, nverts);
+        }
+        PARG_SWAP(uint32_t*, indices, scratch);
+    }
+    if (flags & PARG_OPTIMIZE_OVERDRAW) {
+        parg_vertex_attrib const* attrib = &mesh->layout[PARG_MESH_COORD];
+        parg_assert(attrib->ncomps == 3 && attrib->type == PARG_FLOAT,
+            "Overdraw optimization requires float3 coordinates");
+        float const* coords = parg_buffer_lock(mesh->coords, PARG_READ);
+        for (int r = 0; r < nranges; r++) {
+            int first = ranges[r].start * 3;
+            optimize_overdraw(scratch + first, indices + first,
+                ranges[r].ntriangles, nverts, coords);
+        }
+        parg_buffer_unlock(mesh->coords);
+        PARG_SWAP(uint32_t*, indices, scratch);
+    }
+    if (flags & PARG_OPTIMIZE_VFETCH) {
+        optimize_vfetch(indices, ntris * 3, nverts, mesh);
+    }
+    parg_mesh_write_indices(mesh, indices, ntris);
+    free(indices);
+    free(scratch);
+}
@@ -0,0 +1,230 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <math.h>
+#include "internal.h"
+
+// Parametric surfaces are evaluated one row (constant u) at a time, in
+// batches of v values stored as structures-of-arrays.  The batch loops are
+// free of branches, calls and integer conversions so that the compiler can
+// vectorize them (check with -fopt-info-vec), which is why sine and cosine
+// are approximated here rather than taken from libm.  Rows are distributed
+// across threads with parg_parallel_for.
+
+#define BATCH_SIZE 64
+#define ROW_GRAIN 16
+
+typedef struct parametric_s parametric;
+
+// Evaluates n points at (u, v[i]), writing SoA position, normal and tangent
+// components to out[0..8][i].
+typedef void (*parametric_fn)(parametric const* surf, float u, int n,
+    float const* restrict v, float out[restrict][BATCH_SIZE]);
+
+struct parametric_s {
+    parametric_fn evaluate;
+    int slices;
+    int stacks;
+    float major;
+    float minor;
+    Point3* coords;
+    Vector3* normals;
+    Vector3* tangents;
+    float* uvs;
+    void* indices;
+    parg_data_type indextype;
+};
+
+// Rounds to the nearest integer by pushing the fraction out of the mantissa;
+// valid for |x| < 2^22 under the default rounding mode.
+static inline float round_magic(float x)
+{
+    const float magic = 12582912.0f;
+    return (x + magic) - magic;
+}
+
+// Cody-Waite reduction to [-pi/4, pi/4] followed by the minimax polynomials
+// from Cephes; accurate to about 1e-7 for moderate arguments.  Each input
+// is multiplied by the given scale before evaluation.  The quadrant stays in
+// floating point, since float-to-int conversion and floorf keep GCC from
+// vectorizing the loop on baseline SSE2.
+static void sincos_batch(int n, float const* restrict x, float scale,
+    float* restrict sn, float* restrict cs)
+{
+    const float twobypi = 0.636619772367581f;
+    const float dp1 = 1.5703125f;
+    const float dp2 = 4.837512969970703125e-4f;
+    const float dp3 = 7.54978995489188216e-8f;
+    for (int i = 0; i < n; i++) {
+        float xi = x[i] * scale;
+        float q = round_magic(xi * twobypi);
+        float odd = q - 2.0f * round_magic(q * 0.5f - 0.25f);
+        float quadrant = q - 4.0f * round_magic(q * 0.25f - 0.375f);
+        float r = ((xi - q * dp1) - q * dp2) - q * dp3;
+        float z = r * r;
+        float s = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z -
+            1.6666654611e-1f) * z * r + r;
+        float c = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z +
+            4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+        float ss = odd > 0.5f ? c : s;
+        float cc = odd > 0.5f ? s : c;
+        sn[i] = quadrant > 1.5f ? -ss : ss;
+        cs[i] = fabsf(quadrant - 1.5f) < 1.0f ? -cc : cc;
+    }
+}
+
+// The torus normal points inwards, as it did when normals were computed by
+// finite differences; the clipping demo lights the inside of the tube.
+static void torus_fn(parametric const* surf, float u, int n,
+    float const* restrict v, float out[restrict][BATCH_SIZE])
+{
+    float theta = u * PARG_TWOPI;
+    float sintheta = sinf(theta), costheta = cosf(theta);
+    float sinphi[BATCH_SIZE], cosphi[BATCH_SIZE];
+    sincos_batch(n, v, PARG_TWOPI, sinphi, cosphi);
+    float major = surf->major, minor = surf->minor;
+    for (int i = 0; i < n; i++) {
+        float beta = major + minor * cosphi[i];
+        out[0][i] = costheta * beta;
+        out[1][i] = sintheta * beta;
+        out[2][i] = sinphi[i] * minor;
+        out[3][i] = -cosphi[i] * costheta;
+        out[4][i] = -cosphi[i] * sintheta;
+        out[5][i] = -sinphi[i];
+        out[6][i] = -sintheta;
+        out[7][i] = costheta;
+        out[8][i] = 0;
+    }
+}
+
+// Tube of radius d around a (3, 2) torus knot.  Since the tube's frame is
+// orthonormal and perpendicular to the curve, the surface normal is simply
+// the radial direction and the tangent follows the curve.
+static void knot_fn(parametric const* surf, float s, int n,
+    float const* restrict t, float out[restrict][BATCH_SIZE])
+{
+    const float a = 0.5f;
+    const float b = 0.3f;
+    const float c = 0.5f;
+    const float d = 0.1f;
+    const float u = (1 - s) * 2 * PARG_TWOPI;
+    const float r = a + b * cosf(1.5f * u);
+    Vector3 center = {r * cosf(u), r * sinf(u), c * sinf(1.5f * u)};
+
+    Vector3 dv;
+    dv.x = -1.5f * b * sinf(1.5f * u) * cosf(u) - r * sinf(u);
+    dv.y = -1.5f * b * sinf(1.5f * u) * sinf(u) + r * cosf(u);
+    dv.z = 1.5f * c * cosf(1.5f * u);
+    Vector3 q = V3Normalize(dv);
+    Vector3 qvn = V3Normalize((Vector3){q.y, -q.x, 0});
+    Vector3 ww = V3Cross(q, qvn);
+
+    float sinv[BATCH_SIZE], cosv[BATCH_SIZE];
+    sincos_batch(n, t, PARG_TWOPI, sinv, cosv);
+    for (int i = 0; i < n; i++) {
+        float nx = qvn.x * cosv[i] + ww.x * sinv[i];
+        float ny = qvn.y * cosv[i] + ww.y * sinv[i];
+        float nz = ww.z * sinv[i];
+        out[0][i] = center.x + d * nx;
+        out[1][i] = center.y + d * ny;
+        out[2][i] = center.z + d * nz;
+        out[3][i] = nx;
+        out[4][i] = ny;
+        out[5][i] = nz;
+        out[6][i] = -q.x;
+        out[7][i] = -q.y;
+        out[8][i] = -q.z;
+    }
+}
+
+static void write_row_indices(parametric const* surf, int row)
+{
+    int width = surf->stacks + 1;
+    int first = row * surf->stacks * 6;
+    for (int j = 0; j < surf->stacks; j++) {
+        uint32_t a = row * width + j;
+        uint32_t b = a + width;
+        uint32_t tri[6] = {b + 1, a + 1, a, a, b, b + 1};
+        for (int k = 0; k < 6; k++) {
+            if (surf->indextype == PARG_UINT) {
+                ((uint32_t*) surf->indices)[first + j * 6 + k] = tri[k];
+            } else {
+                ((uint16_t*) surf->indices)[first + j * 6 + k] = tri[k];
+            }
+        }
+    }
+}
+
+static void evaluate_rows(int begin, int end, void* userdata)
+{
+    parametric const* surf = userdata;
+    float out[9][BATCH_SIZE];
+    float v[BATCH_SIZE];
+    int width = surf->stacks + 1;
+    for (int row = begin; row < end; row++) {
+        float u = (float) row / surf->slices;
+        for (int j0 = 0; j0 < width; j0 += BATCH_SIZE) {
+            int n = PARG_MIN(BATCH_SIZE, width - j0);
+            for (int i = 0; i < n; i++) {
+                v[i] = (float) (j0 + i) / surf->stacks;
+            }
+            surf->evaluate(surf, u, n, v, out);
+            int first = row * width + j0;
+            for (int i = 0; i < n; i++) {
+                surf->coords[first + i] = (Point3){out[0][i], out[1][i],
+                    out[2][i]};
+                surf->normals[first + i] = (Vector3){out[3][i], out[4][i],
+                    out[5][i]};
+                surf->tangents[first + i] = (Vector3){out[6][i], out[7][i],
+                    out[8][i]};
+                surf->uvs[(first + i) * 2] = u;
+                surf->uvs[(first + i) * 2 + 1] = v[i];
+            }
+        }
+        if (row < surf->slices) {
+            write_row_indices(surf, row);
+        }
+    }
+}
+
+// The seam row and column are duplicated so that texture coordinates can
+// wrap, which yields (slices + 1) * (stacks + 1) vertices.
+static parg_mesh* parametric_mesh(parametric* surf)
+{
+    parg_mesh* mesh = parg_mesh_alloc(3);
+    int nverts = (surf->slices + 1) * (surf->stacks + 1);
+    int vec3size = sizeof(float) * 3;
+    mesh->coords = parg_buffer_alloc(nverts * vec3size, PARG_GPU_ARRAY);
+    mesh->normals = parg_buffer_alloc(nverts * vec3size, PARG_GPU_ARRAY);
+    mesh->tangents = parg_buffer_alloc(nverts * vec3size, PARG_GPU_ARRAY);
+    mesh->uvs = parg_buffer_alloc(nverts * sizeof(float) * 2, PARG_GPU_ARRAY);
+    mesh->ntriangles = surf->slices * surf->stacks * 2;
+    mesh->indextype = nverts > 0xffff ? PARG_UINT : PARG_USHORT;
+    int isize = parg_data_type_size(mesh->indextype);
+    mesh->indices =
+        parg_buffer_alloc(mesh->ntriangles * 3 * isize, PARG_GPU_ELEMENTS);
+    surf->coords = parg_buffer_lock(mesh->coords, PARG_WRITE);
+    surf->normals = parg_buffer_lock(mesh->normals, PARG_WRITE);
+    surf->tangents = parg_buffer_lock(mesh->tangents, PARG_WRITE);
+    surf->uvs = parg_buffer_lock(mesh->uvs, PARG_WRITE);
+    surf->indices = parg_buffer_lock(mesh->indices, PARG_WRITE);
+    surf->indextype = mesh->indextype;
+    parg_parallel_for(surf->slices + 1, ROW_GRAIN, evaluate_rows, surf);
+    parg_buffer_unlock(mesh->coords);
+    parg_buffer_unlock(mesh->normals);
+    parg_buffer_unlock(mesh->tangents);
+    parg_buffer_unlock(mesh->uvs);
+    parg_buffer_unlock(mesh->indices);
+    return mesh;
+}
+
+parg_mesh* parg_mesh_knot(int slices, int stacks, float major, float minor)
+{
+    parametric surf = {knot_fn, slices, stacks, major, minor};
+    return parametric_mesh(&surf);
+}
+
+parg_mesh* parg_mesh_torus(int slices, int stacks, float major, float minor)
+{
+    parametric surf = {torus_fn, slices, stacks, major, minor};
+    return parametric_mesh(&surf);
+}
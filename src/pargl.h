@@ -15,6 +15,12 @@ void pargDrawElementsInstanced(GLenum mode,
  	const void * indices,
  	GLsizei primcount);
 
+void pargMultiDrawElements(GLenum mode,
+    const GLsizei* count,
+    GLenum type,
+    const void* const* indices,
+    GLsizei drawcount);
+
 #else
 
 #define PARGL_STRING const GLchar* const *
@@ -30,6 +36,13 @@ void pargDrawElementsInstanced(GLenum mode,
 #define pargDrawElementsInstanced(a, b, c, d, e) \
     glDrawElementsInstanced(a, b, c, d, e)
 
+#define pargMultiDrawElements(a, b, c, d, e) \
+    glMultiDrawElements(a, b, c, d, e)
+
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
 #endif
 
 void glGenerateMipmap(GLenum target);
@@ -38,4 +51,34 @@ GLuint parg_buffer_gpu_handle(parg_buffer*);
 GLuint parg_shader_attrib_get(parg_token);
 GLint parg_shader_uniform_get(parg_token);
 
+// Location of a uniform in a linked program, and a copy of the last value
+// uploaded to it.  The program retains uniform values, so the copy remains
+// valid across program switches.
+typedef struct {
+    GLint location;
+    int nbytes;
+    float shadow[16];
+} parg_uniform_state;
+
+parg_uniform_state* parg_shader_uniform_state(parg_token);
+GLint parg_uniform_changed(parg_token tok, void const* val, int nbytes);
+void parg_uniformblock_link(GLuint program);
+void parg_uniformblock_apply();
+int parg_state_has_extension(const char* name);
+void parg_state_enable(GLenum cap, int enabled);
+void parg_state_blendfunc(GLenum src, GLenum dst);
+void parg_state_use_program(GLuint program);
+void parg_state_bind_texture(int unit, GLuint texture);
+void parg_state_bind_buffer(GLenum target, GLuint buffer);
+void parg_state_bind_framebuffer(GLuint framebuffer);
+void parg_state_bind_vertex_array(GLuint vao);
+void parg_state_forget_texture(GLuint texture);
+void parg_state_forget_buffer(GLuint buffer);
+void parg_state_forget_program(GLuint program);
+void parg_state_forget_framebuffer(GLuint framebuffer);
+void parg_state_forget_vertex_array(GLuint vao);
+GLuint parg_program_cache_load(uint64_t key);
+void parg_program_cache_hint(GLuint program);
+void parg_program_cache_store(uint64_t key, GLuint program);
+
 extern int _parg_depthtest;
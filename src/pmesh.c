@@ -0,0 +1,283 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lz4.h>
+#include "internal.h"
+
+#if !EMSCRIPTEN
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// A pmesh file is a fixed-size header, followed by a table of chunks,
+// followed by the chunk payloads.  Payloads are 16-byte aligned and hold the
+// raw contents of one mesh buffer, optionally LZ4-compressed.  Since vertex
+// data is stored exactly as it is laid out in memory (including quantized or
+// interleaved layouts), uncompressed payloads are uploaded to the GPU
+// directly from the mapped file.  All fields are little-endian.
+
+#define PMESH_MAGIC 0x48534d50
+#define PMESH_VERSION 1
+#define PMESH_ALIGN 16
+
+enum {
+    PMESH_VERTICES = PARG_MESH_NATTRIBS,
+    PMESH_INDICES,
+    PMESH_SUBMESHES,
+    PMESH_NKINDS
+};
+
+#define PMESH_NAME_SIZE 40
+
+typedef struct {
+    uint32_t ncomps;
+    uint32_t type;
+    uint32_t normalized;
+    uint32_t offset;
+} pmesh_attrib;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nchunks;
+    uint32_t ntriangles;
+    uint32_t indextype;
+    uint32_t stride;
+    uint32_t reserved[2];
+    float dequantize[16];
+    pmesh_attrib layout[PARG_MESH_NATTRIBS];
+} pmesh_header;
+
+typedef struct {
+    uint32_t start;
+    uint32_t ntriangles;
+    float lower[3];
+    float upper[3];
+    char name[PMESH_NAME_SIZE];
+} pmesh_submesh;
+
+// If packedbytes is less than nbytes, the payload is LZ4-compressed.
+typedef struct {
+    uint32_t kind;
+    uint32_t offset;
+    uint32_t nbytes;
+    uint32_t packedbytes;
+} pmesh_chunk;
+
+static int align_offset(int offset)
+{
+    return (offset + PMESH_ALIGN - 1) & ~(PMESH_ALIGN - 1);
+}
+
+// Sub-mesh names are stored as strings because tokens cannot be reversed
+// without the token registry.
+static parg_buffer* pack_submeshes(parg_mesh* mesh)
+{
+    if (!mesh->nsubmeshes) {
+        return 0;
+    }
+    int nbytes = mesh->nsubmeshes * sizeof(pmesh_submesh);
+    parg_buffer* buf = parg_buffer_alloc(nbytes, PARG_CPU);
+    pmesh_submesh* dst = parg_buffer_lock(buf, PARG_WRITE);
+    memset(dst, 0, nbytes);
+    for (int s = 0; s < mesh->nsubmeshes; s++, dst++) {
+        parg_submesh const* src = mesh->submeshes + s;
+        dst->start = src->start;
+        dst->ntriangles = src->ntriangles;
+        memcpy(dst->lower, &src->lower, sizeof(dst->lower));
+        memcpy(dst->upper, &src->upper, sizeof(dst->upper));
+        if (src->name) {
+            char const* name = parg_token_to_string(src->name);
+            strncpy(dst->name, name, PMESH_NAME_SIZE - 1);
+        }
+    }
+    parg_buffer_unlock(buf);
+    return buf;
+}
+
+static void unpack_submeshes(parg_mesh* mesh, parg_buffer* buf)
+{
+    pmesh_submesh const* src = parg_buffer_lock(buf, PARG_READ);
+    mesh->nsubmeshes = parg_buffer_length(buf) / sizeof(pmesh_submesh);
+    mesh->submeshes = malloc(sizeof(parg_submesh) * mesh->nsubmeshes);
+    for (int s = 0; s < mesh->nsubmeshes; s++, src++) {
+        parg_submesh* dst = mesh->submeshes + s;
+        char name[PMESH_NAME_SIZE + 1] = {0};
+        memcpy(name, src->name, PMESH_NAME_SIZE);
+        dst->start = src->start;
+        dst->ntriangles = src->ntriangles;
+        dst->name = name[0] ? parg_token_from_string(name) : 0;
+        memcpy(&dst->lower, src->lower, sizeof(src->lower));
+        memcpy(&dst->upper, src->upper, sizeof(src->upper));
+    }
+    parg_buffer_unlock(buf);
+    parg_buffer_free(buf);
+}
+
+static void gather_buffers(parg_mesh* mesh, parg_buffer** buffers)
+{
+    buffers[PARG_MESH_COORD] = mesh->coords;
+    buffers[PARG_MESH_UV] = mesh->uvs;
+    buffers[PARG_MESH_NORMAL] = mesh->normals;
+    buffers[PARG_MESH_TANGENT] = mesh->tangents;
+    buffers[PMESH_VERTICES] = mesh->vertices;
+    buffers[PMESH_INDICES] = mesh->indices;
+    buffers[PMESH_SUBMESHES] = pack_submeshes(mesh);
+}
+
+void parg_mesh_to_file(parg_mesh* mesh, const char* filepath, int flags)
+{
+    parg_buffer* buffers[PMESH_NKINDS];
+    gather_buffers(mesh, buffers);
+    pmesh_header header = {0};
+    header.magic = PMESH_MAGIC;
+    header.version = PMESH_VERSION;
+    header.ntriangles = mesh->ntriangles;
+    header.indextype = mesh->indextype;
+    header.stride = mesh->stride;
+    memcpy(header.dequantize, &mesh->dequantize, sizeof(header.dequantize));
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        parg_vertex_attrib const* src = &mesh->layout[a];
+        header.layout[a] = (pmesh_attrib){
+            src->ncomps, src->type, src->normalized, src->offset};
+    }
+
+    pmesh_chunk chunks[PMESH_NKINDS];
+    char* payloads[PMESH_NKINDS];
+    for (int k = 0; k < PMESH_NKINDS; k++) {
+        if (!buffers[k]) {
+            continue;
+        }
+        parg_assert(!parg_buffer_gpu_check(buffers[k]), "CPU mesh required");
+        int nbytes = parg_buffer_length(buffers[k]);
+        char* src = parg_buffer_lock(buffers[k], PARG_READ);
+        char* payload = malloc(PARG_MAX(nbytes, LZ4_compressBound(nbytes)));
+        int packedbytes = 0;
+        if (flags & PARG_PMESH_LZ4) {
+            packedbytes = LZ4_compress_default(
+                src, payload, nbytes, LZ4_compressBound(nbytes));
+        }
+        if (packedbytes <= 0 || packedbytes >= nbytes) {
+            memcpy(payload, src, nbytes);
+            packedbytes = nbytes;
+        }
+        parg_buffer_unlock(buffers[k]);
+        payloads[header.nchunks] = payload;
+        chunks[header.nchunks++] = (pmesh_chunk){k, 0, nbytes, packedbytes};
+    }
+    parg_buffer_free(buffers[PMESH_SUBMESHES]);
+    int offset = sizeof(header) + header.nchunks * sizeof(pmesh_chunk);
+    for (int c = 0; c < header.nchunks; c++) {
+        chunks[c].offset = offset = align_offset(offset);
+        offset += chunks[c].packedbytes;
+    }
+
+    FILE* f = fopen(filepath, "wb");
+    parg_verify(f, "Unable to open file", filepath);
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(chunks, sizeof(pmesh_chunk), header.nchunks, f);
+    const char zeros[PMESH_ALIGN] = {0};
+    for (int c = 0; c < header.nchunks; c++) {
+        fwrite(zeros, 1, chunks[c].offset - ftell(f), f);
+        fwrite(payloads[c], 1, chunks[c].packedbytes, f);
+        free(payloads[c]);
+    }
+    fclose(f);
+}
+
+int parg_pmesh_check(void const* data, int nbytes)
+{
+    return nbytes >= (int) sizeof(pmesh_header) &&
+        ((pmesh_header const*) data)->magic == PMESH_MAGIC;
+}
+
+void parg_load_pmesh(parg_mesh* mesh, void const* data, int nbytes)
+{
+    pmesh_header const* header = data;
+    parg_assert(parg_pmesh_check(data, nbytes), "Not a pmesh");
+    parg_assert(header->version == PMESH_VERSION, "Unsupported pmesh version");
+    pmesh_chunk const* chunks = (pmesh_chunk const*) (header + 1);
+    parg_assert(sizeof(*header) + header->nchunks * sizeof(pmesh_chunk) <=
+        nbytes, "Truncated pmesh");
+    mesh->ntriangles = header->ntriangles;
+    mesh->indextype = header->indextype;
+    mesh->stride = header->stride;
+    memcpy(&mesh->dequantize, header->dequantize, sizeof(header->dequantize));
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        pmesh_attrib const* src = &header->layout[a];
+        mesh->layout[a] = (parg_vertex_attrib){
+            src->ncomps, src->type, src->normalized, src->offset};
+    }
+
+    parg_buffer* buffers[PMESH_NKINDS] = {0};
+    for (int c = 0; c < header->nchunks; c++) {
+        pmesh_chunk const* chunk = chunks + c;
+        parg_assert(chunk->kind < PMESH_NKINDS, "Bad pmesh chunk");
+        parg_assert(chunk->offset + chunk->packedbytes <= nbytes,
+            "Truncated pmesh");
+        char const* src = (char const*) data + chunk->offset;
+        parg_buffer_type memtype = chunk->kind == PMESH_INDICES
+            ? PARG_GPU_ELEMENTS : PARG_GPU_ARRAY;
+        if (chunk->kind == PMESH_SUBMESHES) {
+            memtype = PARG_CPU;
+        }
+        if (chunk->packedbytes == chunk->nbytes) {
+            buffers[chunk->kind] =
+                parg_buffer_create((void*) src, chunk->nbytes, memtype);
+            continue;
+        }
+        parg_buffer* dst = parg_buffer_alloc(chunk->nbytes, memtype);
+        char* pdst = parg_buffer_lock(dst, PARG_WRITE);
+        int unpacked = LZ4_decompress_safe(
+            src, pdst, chunk->packedbytes, chunk->nbytes);
+        parg_assert(unpacked == chunk->nbytes, "Corrupt pmesh chunk");
+        parg_buffer_unlock(dst);
+        buffers[chunk->kind] = dst;
+    }
+    mesh->coords = buffers[PARG_MESH_COORD];
+    mesh->uvs = buffers[PARG_MESH_UV];
+    mesh->normals = buffers[PARG_MESH_NORMAL];
+    mesh->tangents = buffers[PARG_MESH_TANGENT];
+    mesh->vertices = buffers[PMESH_VERTICES];
+    mesh->indices = buffers[PMESH_INDICES];
+    if (buffers[PMESH_SUBMESHES]) {
+        unpack_submeshes(mesh, buffers[PMESH_SUBMESHES]);
+    }
+}
+
+// Returns 0 without modifying the mesh if the file is not a pmesh.
+int parg_load_pmesh_file(parg_mesh* mesh, const char* filepath)
+{
+#if EMSCRIPTEN
+    parg_buffer* buf = parg_buffer_from_file(filepath);
+    void* data = parg_buffer_lock(buf, PARG_READ);
+    int nbytes = parg_buffer_length(buf);
+    int ispmesh = parg_pmesh_check(data, nbytes);
+    if (ispmesh) {
+        parg_load_pmesh(mesh, data, nbytes);
+    }
+    parg_buffer_unlock(buf);
+    parg_buffer_free(buf);
+    return ispmesh;
+#else
+    int fd = open(filepath, O_RDONLY);
+    parg_verify(fd >= 0, "Unable to open file", filepath);
+    struct stat info;
+    fstat(fd, &info);
+    int nbytes = info.st_size;
+    void* data = nbytes > 0
+        ? mmap(0, nbytes, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    int ispmesh = parg_pmesh_check(data, nbytes);
+    if (ispmesh) {
+        parg_load_pmesh(mesh, data, nbytes);
+    }
+    munmap(data, nbytes);
+    return ispmesh;
+#endif
+}
@@ -0,0 +1,176 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+#include "pargl.h"
+
+// FNV-1a, chained through the seed so that several blobs can be combined.
+uint64_t parg_hash_bytes(void const* data, int nbytes, uint64_t seed)
+{
+    unsigned char const* bytes = data;
+    uint64_t hash = seed;
+    for (int i = 0; i < nbytes; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+#if EMSCRIPTEN
+
+GLuint parg_program_cache_load(uint64_t key) { return 0; }
+
+void parg_program_cache_hint(GLuint program) {}
+
+void parg_program_cache_store(uint64_t key, GLuint program) {}
+
+#else
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+// Linked programs are saved with glGetProgramBinary in a directory next to
+// the executable, one file per program.  The file name is derived from the
+// caller's key mixed with the driver strings, so a driver update simply
+// misses the cache.  A file is trusted only if its header, size, and payload
+// checksum all agree, and even then the driver may reject the binary, in
+// which case the file is removed and the caller compiles from source.
+
+#define CACHE_DIRECTORY "programcache/"
+#define CACHE_MAGIC 0x50524750
+#define CACHE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t checksum;
+    uint32_t format;
+    uint32_t nbytes;
+} cache_header;
+
+static int _cache_enabled = -1;
+static uint64_t _driver_hash = 0;
+
+static int cache_enabled()
+{
+    if (_cache_enabled < 0) {
+        GLint nformats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nformats);
+        _cache_enabled = nformats > 0;
+        GLenum const names[] = {
+            GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+        _driver_hash = PARG_HASH_SEED;
+        for (int i = 0; i < 4; i++) {
+            char const* str = (char const*) glGetString(names[i]);
+            if (str) {
+                _driver_hash = parg_hash_bytes(str, strlen(str), _driver_hash);
+            }
+        }
+    }
+    return _cache_enabled;
+}
+
+static sds cache_path(uint64_t key)
+{
+    sds path = sdscat(sdsdup(parg_asset_whereami()), CACHE_DIRECTORY);
+    mkdir(path, 0755);
+    key = parg_hash_bytes(&key, sizeof(key), _driver_hash);
+    return sdscatprintf(path, "%016llx.bin", (unsigned long long) key);
+}
+
+static void* read_payload(sds path, uint64_t key, cache_header* header)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    void* payload = 0;
+    if (fread(header, sizeof(*header), 1, file) == 1 &&
+        header->magic == CACHE_MAGIC && header->version == CACHE_VERSION &&
+        header->key == key && header->nbytes > 0) {
+        payload = malloc(header->nbytes);
+        if (fread(payload, 1, header->nbytes, file) != header->nbytes ||
+            fgetc(file) != EOF ||
+            parg_hash_bytes(payload, header->nbytes, PARG_HASH_SEED) !=
+                header->checksum) {
+            free(payload);
+            payload = 0;
+        }
+    }
+    fclose(file);
+    return payload;
+}
+
+// Returns a linked program, or zero if the cache has no usable binary.
+GLuint parg_program_cache_load(uint64_t key)
+{
+    if (!cache_enabled()) {
+        return 0;
+    }
+    sds path = cache_path(key);
+    cache_header header;
+    void* payload = read_payload(path, key, &header);
+    GLuint program = 0;
+    if (payload) {
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, payload, header.nbytes);
+        free(payload);
+        GLint link_success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &link_success);
+        if (!link_success) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (!program) {
+        remove(path);
+    }
+    sdsfree(path);
+    return program;
+}
+
+// Must be called before linking a program that will be stored.
+void parg_program_cache_hint(GLuint program)
+{
+    if (cache_enabled()) {
+        glProgramParameteri(
+            program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+// Failures are silent since the cache is only an optimization.  The file is
+// written under a temporary name and then renamed, so a concurrent launch
+// never sees a partial file.
+void parg_program_cache_store(uint64_t key, GLuint program)
+{
+    if (!cache_enabled()) {
+        return;
+    }
+    GLint nbytes = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &nbytes);
+    if (nbytes <= 0) {
+        return;
+    }
+    void* payload = malloc(nbytes);
+    GLenum format;
+    GLsizei length = 0;
+    glGetProgramBinary(program, nbytes, &length, &format, payload);
+    cache_header header = {CACHE_MAGIC, CACHE_VERSION, key,
+        parg_hash_bytes(payload, length, PARG_HASH_SEED), format, length};
+    sds path = cache_path(key);
+    sds tmppath = sdscat(sdsdup(path), ".tmp");
+    FILE* file = length > 0 ? fopen(tmppath, "wb") : 0;
+    if (file) {
+        int success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(payload, 1, length, file) == length;
+        success = !fclose(file) && success;
+        if (!success || rename(tmppath, path)) {
+            remove(tmppath);
+        }
+    }
+    free(payload);
+    sdsfree(tmppath);
+    sdsfree(path);
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "internal.h"
+
+// Quantized normals use the octahedral encoding from Cigolle et al, "A Survey
+// of Efficient Representations for Independent Unit Vectors".  Shaders must
+// decode them before use, e.g.:
+//
+//     vec3 oct_decode(vec2 e) {
+//         vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//         vec2 s = vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+//         if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * s;
+//         return normalize(n);
+//     }
+//
+// Quantized positions are unsigned normalized values relative to the mesh
+// bounding box, so the model matrix must be multiplied by the matrix returned
+// from parg_mesh_dequantize_matrix.  Half-float texture coordinates require
+// GL 3.0 or WebGL 2; use PARG_QUANTIZE_UV16 on older targets.
+
+static float signnz(float v) { return v >= 0 ? 1.0f : -1.0f; }
+
+static void oct_encode(Vector3 n, float* e)
+{
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float x = l1 > 0 ? n.x / l1 : 0;
+    float y = l1 > 0 ? n.y / l1 : 0;
+    if (n.z < 0) {
+        float ox = x;
+        x = (1 - fabsf(y)) * signnz(ox);
+        y = (1 - fabsf(ox)) * signnz(y);
+    }
+    e[0] = x;
+    e[1] = y;
+}
+
+static Vector3 oct_decode(float const* e)
+{
+    Vector3 n = {e[0], e[1], 1 - fabsf(e[0]) - fabsf(e[1])};
+    if (n.z < 0) {
+        float ox = n.x;
+        n.x = (1 - fabsf(n.y)) * signnz(ox);
+        n.y = (1 - fabsf(ox)) * signnz(n.y);
+    }
+    return V3Normalize(n);
+}
+
+static uint16_t float_to_half(float f)
+{
+    union {
+        float f;
+        uint32_t u;
+    } bits = {f};
+    uint32_t sign = (bits.u >> 16) & 0x8000;
+    int exponent = (int) ((bits.u >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits.u & 0x7fffff;
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) {
+            half++;
+        }
+        return sign | half;
+    }
+    if (exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) {
+        half++;
+    }
+    return half;
+}
+
+static float half_to_float(uint16_t h)
+{
+    int exponent = (h >> 10) & 0x1f;
+    float mantissa = h & 0x3ff;
+    float value;
+    if (exponent == 0) {
+        value = ldexpf(mantissa, -24);
+    } else if (exponent == 31) {
+        value = INFINITY;
+    } else {
+        value = ldexpf(mantissa + 1024, exponent - 25);
+    }
+    return (h & 0x8000) ? -value : value;
+}
+
+static void quantize_positions(parg_mesh* mesh, int nverts, float* error)
+{
+    float const* src = parg_buffer_lock(mesh->coords, PARG_READ);
+    Vector3 lo = {INFINITY, INFINITY, INFINITY};
+    Vector3 hi = {-INFINITY, -INFINITY, -INFINITY};
+    for (int v = 0; v < nverts; v++) {
+        Vector3 p = *((Vector3 const*) src + v);
+        lo = V3MinPerElem(lo, p);
+        hi = V3MaxPerElem(hi, p);
+    }
+    Vector3 extent = V3Sub(hi, lo);
+    extent.x = extent.x > 0 ? extent.x : 1;
+    extent.y = extent.y > 0 ? extent.y : 1;
+    extent.z = extent.z > 0 ? extent.z : 1;
+    float const* plo = &lo.x;
+    float const* pextent = &extent.x;
+
+    parg_buffer* dst = parg_buffer_alloc(nverts * 6, PARG_CPU);
+    uint16_t* pdst = parg_buffer_lock(dst, PARG_WRITE);
+    for (int i = 0; i < nverts * 3; i++) {
+        float t = (src[i] - plo[i % 3]) / pextent[i % 3];
+        pdst[i] = (uint16_t) (PARG_CLAMP(t, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        float decoded = plo[i % 3] + pextent[i % 3] * (pdst[i] / 65535.0f);
+        *error = PARG_MAX(*error, fabsf(decoded - src[i]));
+    }
+    parg_buffer_unlock(dst);
+    parg_buffer_unlock(mesh->coords);
+    parg_buffer_free(mesh->coords);
+    mesh->coords = dst;
+    mesh->layout[PARG_MESH_COORD] = (parg_vertex_attrib){3, PARG_USHORT, 1, 0};
+    mesh->dequantize = M4Mul(M4MakeTranslation(lo), M4MakeScale(extent));
+}
+
+static void quantize_normals(parg_mesh* mesh, int nverts, int bits,
+    float* error)
+{
+    float const* src = parg_buffer_lock(mesh->normals, PARG_READ);
+    int size = bits / 8;
+    float scale = (1 << (bits - 1)) - 1;
+    parg_buffer* dst = parg_buffer_alloc(nverts * 2 * size, PARG_CPU);
+    void* pdst = parg_buffer_lock(dst, PARG_WRITE);
+    for (int v = 0; v < nverts; v++) {
+        Vector3 n = V3Normalize(*((Vector3 const*) src + v));
+        float e[2];
+        oct_encode(n, e);
+        for (int c = 0; c < 2; c++) {
+            int q = (int) roundf(PARG_CLAMP(e[c], -1.0f, 1.0f) * scale);
+            if (size == 1) {
+                ((int8_t*) pdst)[v * 2 + c] = q;
+            } else {
+                ((int16_t*) pdst)[v * 2 + c] = q;
+            }
+            e[c] = PARG_MAX(q / scale, -1.0f);
+        }
+        float cosine = V3Dot(n, oct_decode(e));
+        *error = PARG_MAX(*error, acosf(PARG_CLAMP(cosine, -1.0f, 1.0f)));
+    }
+    parg_buffer_unlock(dst);
+    parg_buffer_unlock(mesh->normals);
+    parg_buffer_free(mesh->normals);
+    mesh->normals = dst;
+    parg_data_type type = size == 1 ? PARG_BYTE : PARG_SHORT;
+    mesh->layout[PARG_MESH_NORMAL] = (parg_vertex_attrib){2, type, 1, 0};
+}
+
+static void quantize_uvs(parg_mesh* mesh, int nverts, int half, float* error)
+{
+    float const* src = parg_buffer_lock(mesh->uvs, PARG_READ);
+    parg_buffer* dst = parg_buffer_alloc(nverts * 4, PARG_CPU);
+    uint16_t* pdst = parg_buffer_lock(dst, PARG_WRITE);
+    for (int i = 0; i < nverts * 2; i++) {
+        float decoded;
+        if (half) {
+            pdst[i] = float_to_half(src[i]);
+            decoded = half_to_float(pdst[i]);
+        } else {
+            float t = PARG_CLAMP(src[i], 0.0f, 1.0f);
+            pdst[i] = (uint16_t) (t * 65535.0f + 0.5f);
+            decoded = pdst[i] / 65535.0f;
+        }
+        *error = PARG_MAX(*error, fabsf(decoded - src[i]));
+    }
+    parg_buffer_unlock(dst);
+    parg_buffer_unlock(mesh->uvs);
+    parg_buffer_free(mesh->uvs);
+    mesh->uvs = dst;
+    mesh->layout[PARG_MESH_UV] = half
+        ? (parg_vertex_attrib){2, PARG_HALF, 0, 0}
+        : (parg_vertex_attrib){2, PARG_USHORT, 1, 0};
+}
+
+static int is_float(parg_mesh* mesh, int attrib)
+{
+    return mesh->layout[attrib].type == PARG_FLOAT;
+}
+
+void parg_mesh_quantize(parg_mesh* mesh, int flags, parg_quantize_error* err)
+{
+    parg_assert(mesh->coords, "Non-interleaved mesh required");
+    parg_assert(!parg_buffer_gpu_check(mesh->coords), "CPU mesh required");
+    int nverts = parg_mesh_nverts(mesh);
+    parg_quantize_error result = {0, 0, 0};
+    if ((flags & PARG_QUANTIZE_POSITION) && is_float(mesh, PARG_MESH_COORD)) {
+        parg_assert(mesh->layout[PARG_MESH_COORD].ncomps == 3,
+            "Position quantization requires float3 coordinates");
+        quantize_positions(mesh, nverts, &result.position);
+    }
+    if ((flags & (PARG_QUANTIZE_NORMAL8 | PARG_QUANTIZE_NORMAL16)) &&
+        mesh->normals && is_float(mesh, PARG_MESH_NORMAL)) {
+        int bits = (flags & PARG_QUANTIZE_NORMAL16) ? 16 : 8;
+        quantize_normals(mesh, nverts, bits, &result.normal);
+    }
+    if ((flags & (PARG_QUANTIZE_UV_HALF | PARG_QUANTIZE_UV16)) && mesh->uvs &&
+        is_float(mesh, PARG_MESH_UV)) {
+        int half = (flags & PARG_QUANTIZE_UV_HALF) != 0;
+        quantize_uvs(mesh, nverts, half, &result.uv);
+    }
+    if (err) {
+        *err = result;
+    }
+}
+
+Matrix4 parg_mesh_dequantize_matrix(parg_mesh* mesh)
+{
+    return mesh->dequantize;
+}
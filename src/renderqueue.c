@@ -0,0 +1,232 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+#include "pargl.h"
+#include "kvec.h"
+
+// Items are recorded without touching GL, so a queue can be filled from any
+// thread as long as each queue has one writer at a time.  Submission happens
+// on the GL thread, where the items from every queue are sorted by a 64-bit
+// key and then drawn, skipping any state that matches the previous item.
+// The key fields are hashes, so a collision only costs an extra state change.
+// Storage grows as needed and is reused after parg_renderqueue_clear.
+
+typedef struct {
+    parg_token token;
+    GLenum type;
+    int ncomps;
+    union {
+        float f[16];
+        int i;
+    } value;
+} queued_uniform;
+
+typedef struct {
+    parg_render_item item;
+    uint64_t key;
+    int first_uniform;
+    int nuniforms;
+} queued_item;
+
+typedef struct {
+    uint64_t key;
+    queued_item const* item;
+    queued_uniform const* uniforms;
+    int order;
+} sort_entry;
+
+struct parg_renderqueue_s {
+    kvec_t(queued_item) items;
+    kvec_t(queued_uniform) uniforms;
+};
+
+static kvec_t(sort_entry) _entries;
+
+parg_renderqueue* parg_renderqueue_create()
+{
+    return calloc(1, sizeof(struct parg_renderqueue_s));
+}
+
+void parg_renderqueue_free(parg_renderqueue* queue)
+{
+    if (!queue) {
+        return;
+    }
+    kv_destroy(queue->items);
+    kv_destroy(queue->uniforms);
+    free(queue);
+}
+
+void parg_renderqueue_clear(parg_renderqueue* queue)
+{
+    kv_size(queue->items) = 0;
+    kv_size(queue->uniforms) = 0;
+}
+
+static uint64_t key_bits(void const* data, int nbytes, int nbits)
+{
+    uint64_t hash = parg_hash_bytes(data, nbytes, PARG_HASH_SEED);
+    return (hash ^ (hash >> 32)) & ((1ull << nbits) - 1);
+}
+
+// From the most significant bits: pass (8), blending (1), then program
+// (16), textures (12), layout (11), and depth (16).  Within a pass, blended
+// items follow opaque ones and move depth to the top of the state fields,
+// so they are drawn back to front across all programs, textures and
+// layouts.  Non-negative floats sort like their bit patterns.
+static uint64_t item_key(parg_render_item const* item)
+{
+    uint32_t program[2] = {item->program, item->variant};
+    float depth = PARG_MAX(item->depth, 0);
+    uint32_t depthbits;
+    memcpy(&depthbits, &depth, sizeof(depthbits));
+    depthbits >>= 16;
+    uint64_t state = key_bits(program, sizeof(program), 16) << 23 |
+        key_bits(item->textures, sizeof(item->textures), 12) << 11 |
+        key_bits(&item->layout, sizeof(item->layout), 11);
+    uint64_t key = (uint64_t) (item->pass & 0xff) << 56;
+    if (item->blending) {
+        return key | 1ull << 55 | (uint64_t) (0xffff - depthbits) << 39 |
+            state;
+    }
+    return key | state << 16 | depthbits;
+}
+
+void parg_renderqueue_add(parg_renderqueue* queue, parg_render_item const* item)
+{
+    queued_item queued = {*item, item_key(item), kv_size(queue->uniforms), 0};
+    kv_push(queued_item, queue->items, queued);
+}
+
+static void push_uniform(parg_renderqueue* queue, queued_uniform const* u)
+{
+    parg_assert(kv_size(queue->items), "No render item");
+    kv_push(queued_uniform, queue->uniforms, *u);
+    kv_A(queue->items, kv_size(queue->items) - 1).nuniforms++;
+}
+
+// Attaches a float uniform to the most recently added item.  Matrices are
+// column-major with 9 or 16 floats.
+void parg_renderqueue_uniform(
+    parg_renderqueue* queue, parg_token tok, void const* value, int nfloats)
+{
+    parg_assert(nfloats >= 1 && nfloats <= 16, "Bad uniform size");
+    queued_uniform uniform = {tok, GL_FLOAT, nfloats};
+    memcpy(uniform.value.f, value, sizeof(float) * nfloats);
+    push_uniform(queue, &uniform);
+}
+
+// Attaches an int, bool or sampler uniform to the most recent item.
+void parg_renderqueue_uniform1i(
+    parg_renderqueue* queue, parg_token tok, int value)
+{
+    queued_uniform uniform = {tok, GL_INT, 1};
+    uniform.value.i = value;
+    push_uniform(queue, &uniform);
+}
+
+// Ties fall back to submission order so that the result is deterministic.
+static int compare_entries(void const* a, void const* b)
+{
+    sort_entry const* x = a;
+    sort_entry const* y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return x->order - y->order;
+}
+
+static void upload_uniform(queued_uniform const* uniform)
+{
+    if (uniform->type == GL_INT) {
+        parg_uniform1i(uniform->token, uniform->value.i);
+        return;
+    }
+    int nbytes = sizeof(float) * uniform->ncomps;
+    GLint loc = parg_uniform_changed(uniform->token, uniform->value.f, nbytes);
+    if (loc < 0) {
+        return;
+    }
+    float const* value = uniform->value.f;
+    switch (uniform->ncomps) {
+    case 1: glUniform1fv(loc, 1, value); break;
+    case 2: glUniform2fv(loc, 1, value); break;
+    case 3: glUniform3fv(loc, 1, value); break;
+    case 4: glUniform4fv(loc, 1, value); break;
+    case 9: glUniformMatrix3fv(loc, 1, 0, value); break;
+    case 16: glUniformMatrix4fv(loc, 1, 0, value); break;
+    default: parg_assert(0, "Bad uniform size");
+    }
+}
+
+static void draw_item(parg_render_item const* item)
+{
+    if (item->ninstances) {
+        parg_assert(item->indextype == PARG_USHORT ||
+                item->indextype == PARG_UINT,
+            "Instancing requires indices");
+        if (item->indextype == PARG_UINT) {
+            parg_draw_instanced_triangles_u32(
+                item->start, item->ntriangles, item->ninstances);
+        } else {
+            parg_draw_instanced_triangles_u16(
+                item->start, item->ntriangles, item->ninstances);
+        }
+    } else if (item->indextype == PARG_USHORT) {
+        parg_draw_triangles_u16(item->start, item->ntriangles);
+    } else if (item->indextype == PARG_UINT) {
+        parg_draw_triangles_u32(item->start, item->ntriangles);
+    } else {
+        parg_draw_triangles(item->start, item->ntriangles);
+    }
+}
+
+// Sorts the items from all of the given queues together and draws them.  The
+// queues are left intact, so they can be submitted again.
+void parg_renderqueue_submit(parg_renderqueue** queues, int nqueues)
+{
+    kv_size(_entries) = 0;
+    for (int q = 0; q < nqueues; q++) {
+        parg_renderqueue const* queue = queues[q];
+        for (int i = 0; i < kv_size(queue->items); i++) {
+            queued_item const* item = &kv_A(queue->items, i);
+            sort_entry entry = {item->key, item,
+                queue->uniforms.a + item->first_uniform, kv_size(_entries)};
+            kv_push(sort_entry, _entries, entry);
+        }
+    }
+    qsort(_entries.a, kv_size(_entries), sizeof(sort_entry), compare_entries);
+    parg_render_item const* prev = 0;
+    for (int e = 0; e < kv_size(_entries); e++) {
+        sort_entry const* entry = &kv_A(_entries, e);
+        parg_render_item const* item = &entry->item->item;
+        if (!prev || item->blending != prev->blending) {
+            parg_state_blending(item->blending);
+        }
+        if (!prev || item->depthtest != prev->depthtest) {
+            parg_state_depthtest(item->depthtest);
+        }
+        if (!prev || item->cullfaces != prev->cullfaces) {
+            parg_state_cullfaces(item->cullfaces);
+        }
+        if (!prev || item->program != prev->program ||
+            item->variant != prev->variant) {
+            parg_shader_bind_variant(item->program, item->variant);
+        }
+        for (int t = 0; t < PARG_RENDER_TEXTURES; t++) {
+            parg_texture* tex = item->textures[t];
+            if (tex && (!prev || tex != prev->textures[t])) {
+                parg_texture_bind(tex, t);
+            }
+        }
+        if (item->layout && (!prev || item->layout != prev->layout)) {
+            parg_varray_layout_bind(item->layout);
+        }
+        for (int u = 0; u < entry->item->nuniforms; u++) {
+            upload_uniform(entry->uniforms + u);
+        }
+        draw_item(item);
+        prev = item;
+    }
+}
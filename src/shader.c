@@ -1,6 +1,7 @@
 #include <parg.h>
 #include "internal.h"
 #include "pargl.h"
+#include <stdlib.h>
 #include <string.h>
 #include "kvec.h"
 #include "khash.h"
@@ -8,27 +9,67 @@
 // Mapping from tokens to sds strings.
 KHASH_MAP_INIT_INT(smap, sds)
 
-// Mapping from tokens to OpenGL handles.
-KHASH_MAP_INIT_INT(glmap, GLuint)
+// A linked program and the state of its uniforms, indexed by uniform slot.
+// Slots that the program does not use have a location of -1.
+typedef struct {
+    GLuint handle;
+    int nuniforms;
+    parg_uniform_state* uniforms;
+} program_info;
+
+// Mapping from tokens to linked programs.
+KHASH_MAP_INIT_INT(glmap, program_info*)
 
 // Mapping from tokens to integer slots.
 KHASH_MAP_INIT_INT(imap, int)
 
+typedef kvec_t (sds) sdsvec;
+
+// Mapping from tokens to the names of permutation flags.
+KHASH_MAP_INIT_INT(fmap, sdsvec)
+
+// Mapping from (program, flag mask) pairs to variant tokens.
+KHASH_MAP_INIT_INT64(vmap, parg_token)
+
+// A program whose compile and link have been submitted but not checked.
+// Programs loaded from the binary cache have no shader handles.
+typedef struct {
+    GLuint program;
+    GLuint vshader;
+    GLuint fshader;
+    uint64_t key;
+} pending_program;
+
+// Mapping from tokens to programs that are still compiling.
+KHASH_MAP_INIT_INT(pmap, pending_program)
+
 static khash_t(smap)* _vshader_registry = 0;
 static khash_t(smap)* _fshader_registry = 0;
 static khash_t(glmap)* _program_registry = 0;
 static khash_t(imap)* _attr_registry = 0;
 static khash_t(imap)* _unif_registry = 0;
-static GLuint _current_program = 0;
-static parg_token _current_program_token = 0;
+static khash_t(pmap)* _pending_registry = 0;
+static khash_t(fmap)* _flag_registry = 0;
+static khash_t(vmap)* _variant_registry = 0;
+static program_info* _current_program = 0;
+
+// Uniform tokens are assigned dense slots as they are first seen, and the
+// most recently used ones are found through a direct-mapped cache in front
+// of the registry.  Entries store the slot plus one, so zero means empty.
+#define SLOT_CACHE_SIZE 256
+
+static struct {
+    parg_token token;
+    int slot;
+} _slot_cache[SLOT_CACHE_SIZE];
 
 #define MAX_SHADER_SPEW 1024
 #define MAX_UNIFORM_LEN 128
+#define MAX_INCLUDE_DEPTH 16
+#define MAX_VARIANT_FLAGS 32
 #define kv_last(vec) kv_A(vec, kv_size(vec) - 1)
 #define chunk_body kv_last(chunk_bodies)
 
-typedef kvec_t (sds) sdsvec;
-
 static int kv_find(sdsvec keys, sds key)
 {
     for (int p = 0; p < kv_size(keys); p++) {
@@ -39,10 +80,116 @@ static int kv_find(sdsvec keys, sds key)
     return -1;
 }
 
+// Replaces each @include line with the body of the named chunk, which may
+// itself contain includes.  Takes ownership of the given body.
+static sds expand_includes(
+    sds body, sdsvec chunk_names, sdsvec chunk_bodies, int depth)
+{
+    const char* INCLUDE = "@include ";
+    const int INCLUDE_LEN = strlen(INCLUDE);
+    if (!strstr(body, INCLUDE)) {
+        return body;
+    }
+    int nlines;
+    sds* lines = sdssplitlen(body, sdslen(body), "\n", 1, &nlines);
+    sds result = sdsempty();
+    for (int j = 0; j < nlines; j++) {
+        if (strncmp(lines[j], INCLUDE, INCLUDE_LEN)) {
+            result = sdscatsds(result, lines[j]);
+            result = sdscat(result, j < nlines - 1 ? "\n" : "");
+            continue;
+        }
+        sds name = sdsnew(lines[j] + INCLUDE_LEN);
+        name = sdstrim(name, " \t");
+        int index = kv_find(chunk_names, name);
+        parg_verify(index > 0, "No such chunk", name);
+        parg_verify(depth < MAX_INCLUDE_DEPTH, "Include depth exceeded", name);
+        sds included = expand_includes(sdsdup(kv_A(chunk_bodies, index)),
+            chunk_names, chunk_bodies, depth + 1);
+        result = sdscatsds(result, included);
+        sdsfree(included);
+        sdsfree(name);
+    }
+    sdsfreesplitres(lines, nlines);
+    sdsfree(body);
+    return result;
+}
+
+static int uniform_slot_add(parg_token tok)
+{
+    int ret;
+    khiter_t iter = kh_put(imap, _unif_registry, tok, &ret);
+    if (ret) {
+        kh_value(_unif_registry, iter) = kh_size(_unif_registry) - 1;
+    }
+    return kh_value(_unif_registry, iter);
+}
+
+static int uniform_slot_find(parg_token tok)
+{
+    int index = tok & (SLOT_CACHE_SIZE - 1);
+    if (_slot_cache[index].token == tok && _slot_cache[index].slot) {
+        return _slot_cache[index].slot - 1;
+    }
+    khiter_t iter = kh_get(imap, _unif_registry, tok);
+    if (iter == kh_end(_unif_registry)) {
+        return -1;
+    }
+    int slot = kh_value(_unif_registry, iter);
+    _slot_cache[index].token = tok;
+    _slot_cache[index].slot = slot + 1;
+    return slot;
+}
+
+// Returns the token for a uniform name, ignoring any array subscript.
+static parg_token uniform_token(const char* name)
+{
+    const char* bracket = strchr(name, '[');
+    if (!bracket) {
+        return parg_token_from_string(name);
+    }
+    sds base = sdsnewlen(name, bracket - name);
+    parg_token tok = parg_token_from_string(base);
+    sdsfree(base);
+    return tok;
+}
+
+// Splits the optional trailing flag list from an @program argument string,
+// as in "p_mesh, vs, fs [SHOWGRID, HIGHP]".
+static sdsvec split_flags(sds argstring)
+{
+    sdsvec flags;
+    kv_init(flags);
+    char* open = strchr(argstring, '[');
+    if (!open) {
+        return flags;
+    }
+    char* close = strchr(open, ']');
+    parg_verify(close, "Unterminated flag list", argstring);
+    int nflags;
+    sds* names = sdssplitlen(open + 1, close - open - 1, ",", 1, &nflags);
+    for (int f = 0; f < nflags; f++) {
+        names[f] = sdstrim(names[f], " \t");
+        if (sdslen(names[f])) {
+            kv_push(sds, flags, sdsdup(names[f]));
+        }
+    }
+    sdsfreesplitres(names, nflags);
+    parg_verify(kv_size(flags) <= MAX_VARIANT_FLAGS, "Too many flags",
+        argstring);
+    sdsrange(argstring, 0, open - argstring - 1);
+    return flags;
+}
+
 void parg_shader_load_from_buffer(parg_buffer* buf)
 {
     const sds ATTRIBUTE = sdsnew("attribute ");
+    const sds UNIFORM = sdsnew("uniform ");
     const sds PROGRAM = sdsnew("@program ");
+    const sds DEFINE = sdsnew("@define ");
+    const sds INCLUDE = sdsnew("@include ");
+    const sds BLOCK = sdsnew("@block ");
+    const sds ENDBLOCK = sdsnew("@endblock");
     const sds PREFIX = sdsnew("_prefix");
 #if defined(__APPLE__) && defined(__MACH__)
     const sds OSX_PREFIX = sdsnew("#version 120\n");
@@ -53,6 +200,10 @@ void parg_shader_load_from_buffer(parg_buffer* buf)
         _fshader_registry = kh_init(smap);
         _attr_registry = kh_init(imap);
         _unif_registry = kh_init(imap);
+        _program_registry = kh_init(glmap);
+        _pending_registry = kh_init(pmap);
+        _flag_registry = kh_init(fmap);
+        _variant_registry = kh_init(vmap);
     }
 
     sdsvec program_args;
@@ -61,6 +212,8 @@ void parg_shader_load_from_buffer(parg_buffer* buf)
     kv_init(chunk_bodies);
     sdsvec chunk_names;
     kv_init(chunk_names);
+    sds defines = sdsempty();
+    int has_blocks = 0;
 
     // Split the buffer into a list of codelines.
     int len = parg_buffer_length(buf);
@@ -83,6 +236,44 @@ void parg_shader_load_from_buffer(parg_buffer* buf)
             chunk_body = sdscatprintf(chunk_body, "#line %d\n", j + 1);
             continue;
         }
+
+        // Defines apply to every shader in the buffer.  Includes are
+        // normalized here and expanded once all chunks are known, followed
+        // by a #line to restore the numbering.
+        char* define = strstr(line, DEFINE);
+        if (define) {
+            sds value = sdsnew(define + sdslen(DEFINE));
+            defines = sdscatprintf(defines, "#define %s\n",
+                sdstrim(value, " \t"));
+            sdsfree(value);
+            chunk_body = sdscat(chunk_body, "\n");
+            continue;
+        }
+        char* include = strstr(line, INCLUDE);
+        if (include) {
+            chunk_body = sdscatprintf(chunk_body, "%s\n#line %d\n", include,
+                j + 2);
+            continue;
+        }
+
+        // Uniform blocks are replaced with GLSL that suits the driver.
+        char* block = strstr(line, BLOCK);
+        if (block) {
+            sds name = sdsnew(block + sdslen(BLOCK));
+            name = sdstrim(name, " \t{");
+            int first = j + 1;
+            while (++j < nlines && !strstr(lines[j], ENDBLOCK)) {
+            }
+            parg_verify(j < nlines, "Unterminated block", name);
+            sds glsl = parg_uniformblock_declare(name, lines + first,
+                j - first);
+            chunk_body = sdscatsds(chunk_body, glsl);
+            chunk_body = sdscatprintf(chunk_body, "#line %d\n", j + 2);
+            has_blocks = 1;
+            sdsfree(glsl);
+            sdsfree(name);
+            continue;
+        }
         chunk_body = sdscatsds(chunk_body, line);
         chunk_body = sdscat(chunk_body, "\n");
         char* program = strstr(line, PROGRAM);
@@ -108,13 +299,34 @@ void parg_shader_load_from_buffer(parg_buffer* buf)
             }
             sdsfree(attr);
         }
+
+        // Assign slots to declared uniforms now, so that they are dense
+        // across programs.  Uniforms missed here are added at link time.
+        char* unif = strstr(line, UNIFORM);
+        if (unif == line && strchr(line, ';')) {
+            int nwords;
+            sds uline = sdsnew(unif + sdslen(UNIFORM));
+            uline = sdstrim(uline, "; \t");
+            sds* words = sdssplitlen(uline, sdslen(uline), " \t", 1, &nwords);
+            uniform_slot_add(uniform_token(words[nwords - 1]));
+            sdsfreesplitres(words, nwords);
+            sdsfree(uline);
+        }
     }
     sdsfreesplitres(lines, nlines);
-    sds prefix_body = kv_A(chunk_bodies, 0);
+    sds prefix_body =
+        sdsnew(has_blocks ? parg_uniformblock_glsl_prefix() : "");
+    prefix_body = sdscatsds(prefix_body, defines);
+    if (sdslen(prefix_body)) {
+        prefix_body = sdscat(prefix_body, "#line 1\n");
+    }
+    prefix_body = sdscatsds(prefix_body, kv_A(chunk_bodies, 0));
+    sdsfree(defines);
 
     // Go back through the @program lines and populate the registry.
     for (int p = 0; p < kv_size(program_args); p++) {
         sds argstring = kv_A(program_args, p);
+        sdsvec flags = split_flags(argstring);
 
         // Extract the three command arguments.
         int nargs = sdslen(argstring);
@@ -147,25 +359,38 @@ void parg_shader_load_from_buffer(parg_buffer* buf)
         sdsfree(tmp);
 #endif
 #endif
+        vshader_body = expand_includes(vshader_body, chunk_names,
+            chunk_bodies, 0);
+        fshader_body = expand_includes(fshader_body, chunk_names,
+            chunk_bodies, 0);
         parg_token program_name = parg_token_from_string(args[0]);
         sdsfreesplitres(args, nargs);
         sdsfree(argstring);
 
         // Insert the vshader and fshader strings into the registries.
+        // Variants are generated from these on first use.
         int ret;
         khiter_t iter;
         iter = kh_put(smap, _vshader_registry, program_name, &ret);
         kh_value(_vshader_registry, iter) = vshader_body;
         iter = kh_put(smap, _fshader_registry, program_name, &ret);
         kh_value(_fshader_registry, iter) = fshader_body;
+        iter = kh_put(fmap, _flag_registry, program_name, &ret);
+        kh_value(_flag_registry, iter) = flags;
     }
 
     kv_destroy(program_args);
     kv_destroy(chunk_bodies);
     kv_destroy(chunk_names);
 
+    sdsfree(prefix_body);
     sdsfree(ATTRIBUTE);
+    sdsfree(UNIFORM);
     sdsfree(PROGRAM);
+    sdsfree(DEFINE);
+    sdsfree(INCLUDE);
+    sdsfree(BLOCK);
+    sdsfree(ENDBLOCK);
     sdsfree(PREFIX);
 }
 
@@ -178,7 +403,54 @@ void parg_shader_load_from_asset(parg_token id)
 
 GLuint parg_shader_attrib(parg_token tok) { return 0; }
 
-static GLuint compile_program(parg_token tok)
+// The cache key covers everything that affects the linked program apart from
+// the driver.  Attribute bindings are summed so that hash table order does
+// not matter.
+static uint64_t program_key(sds vshader_body, sds fshader_body)
+{
+    uint64_t key = parg_hash_bytes(
+        vshader_body, sdslen(vshader_body), PARG_HASH_SEED);
+    key = parg_hash_bytes(fshader_body, sdslen(fshader_body), key);
+    uint64_t bindings = 0;
+    for (khiter_t iter = kh_begin(_attr_registry);
+        iter != kh_end(_attr_registry); ++iter) {
+        if (!kh_exist(_attr_registry, iter)) {
+            continue;
+        }
+        int slot = kh_value(_attr_registry, iter);
+        const char* name = parg_token_to_string(kh_key(_attr_registry, iter));
+        uint64_t hash = parg_hash_bytes(name, strlen(name), PARG_HASH_SEED);
+        bindings += parg_hash_bytes(&slot, sizeof(slot), hash);
+    }
+    return parg_hash_bytes(&bindings, sizeof(bindings), key);
+}
+
+static int _parallel_compile = -1;
+
+// KHR_parallel_shader_compile lets the driver compile on its own threads, and
+// adds a completion query that never blocks.  Without it, status queries
+// simply wait for the compile.
+static int parallel_compile_supported()
+{
+    if (_parallel_compile < 0) {
+        _parallel_compile =
+            parg_state_has_extension("GL_KHR_parallel_shader_compile");
+    }
+    return _parallel_compile;
+}
+
+static GLuint start_shader(GLenum type, sds body)
+{
+    PARGL_STRING ptr = (PARGL_STRING) &body;
+    GLuint handle = glCreateShader(type);
+    glShaderSource(handle, 1, ptr, 0);
+    glCompileShader(handle);
+    return handle;
+}
+
+// Submits the compile and link without querying any status, so that the
+// driver is free to work in the background.
+static pending_program start_program(parg_token tok)
 {
     khiter_t iter;
 
@@ -186,34 +458,24 @@ static GLuint compile_program(parg_token tok)
     parg_verify(iter != kh_end(_vshader_registry), "No vshader",
         parg_token_to_string(tok));
     sds vshader_body = kh_value(_vshader_registry, iter);
-    PARGL_STRING vshader_ptr = (PARGL_STRING) &vshader_body;
 
     iter = kh_get(smap, _fshader_registry, tok);
     parg_verify(iter != kh_end(_fshader_registry), "No fshader",
         parg_token_to_string(tok));
     sds fshader_body = kh_value(_fshader_registry, iter);
-    PARGL_STRING fshader_ptr = (PARGL_STRING) &fshader_body;
 
-    GLchar spew[MAX_SHADER_SPEW];
-    GLint compile_success = 0;
-
-    GLuint vs_handle = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs_handle, 1, vshader_ptr, 0);
-    glCompileShader(vs_handle);
-    glGetShaderiv(vs_handle, GL_COMPILE_STATUS, &compile_success);
-    glGetShaderInfoLog(vs_handle, MAX_SHADER_SPEW, 0, spew);
-    parg_verify(compile_success, parg_token_to_string(tok), spew);
-
-    GLuint fs_handle = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs_handle, 1, fshader_ptr, 0);
-    glCompileShader(fs_handle);
-    glGetShaderiv(fs_handle, GL_COMPILE_STATUS, &compile_success);
-    glGetShaderInfoLog(fs_handle, MAX_SHADER_SPEW, 0, spew);
-    parg_verify(compile_success, parg_token_to_string(tok), spew);
+    pending_program pending = {0};
+    pending.key = program_key(vshader_body, fshader_body);
+    pending.program = parg_program_cache_load(pending.key);
+    if (pending.program) {
+        return pending;
+    }
 
-    GLuint program_handle = glCreateProgram();
-    glAttachShader(program_handle, vs_handle);
-    glAttachShader(program_handle, fs_handle);
+    pending.vshader = start_shader(GL_VERTEX_SHADER, vshader_body);
+    pending.fshader = start_shader(GL_FRAGMENT_SHADER, fshader_body);
+    pending.program = glCreateProgram();
+    glAttachShader(pending.program, pending.vshader);
+    glAttachShader(pending.program, pending.fshader);
 
     for (iter = kh_begin(_attr_registry); iter != kh_end(_attr_registry);
         ++iter) {
@@ -223,34 +485,83 @@ static GLuint compile_program(parg_token tok)
         int slot = kh_value(_attr_registry, iter);
         parg_token tok = kh_key(_attr_registry, iter);
         const char* name = parg_token_to_string(tok);
-        glBindAttribLocation(program_handle, slot, name);
+        glBindAttribLocation(pending.program, slot, name);
+    }
+
+    parg_program_cache_hint(pending.program);
+    glLinkProgram(pending.program);
+    return pending;
+}
+
+static int program_ready(pending_program const* pending)
+{
+    if (!pending->vshader || !parallel_compile_supported()) {
+        return 1;
+    }
+    GLint complete = 0;
+    glGetProgramiv(pending->program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete;
+}
+
+// Checks the results of a submitted program, blocking if it is not ready.
+static GLuint finish_program(parg_token tok, pending_program pending)
+{
+    if (!pending.vshader) {
+        return pending.program;
     }
+    GLchar spew[MAX_SHADER_SPEW];
+    GLint compile_success = 0;
+
+    glGetShaderiv(pending.vshader, GL_COMPILE_STATUS, &compile_success);
+    glGetShaderInfoLog(pending.vshader, MAX_SHADER_SPEW, 0, spew);
+    parg_verify(compile_success, parg_token_to_string(tok), spew);
+
+    glGetShaderiv(pending.fshader, GL_COMPILE_STATUS, &compile_success);
+    glGetShaderInfoLog(pending.fshader, MAX_SHADER_SPEW, 0, spew);
+    parg_verify(compile_success, parg_token_to_string(tok), spew);
 
     GLint link_success;
-    glLinkProgram(program_handle);
-    glGetProgramiv(program_handle, GL_LINK_STATUS, &link_success);
-    glGetProgramInfoLog(program_handle, MAX_SHADER_SPEW, 0, spew);
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &link_success);
+    glGetProgramInfoLog(pending.program, MAX_SHADER_SPEW, 0, spew);
     parg_verify(link_success, parg_token_to_string(tok), spew);
+    glDetachShader(pending.program, pending.vshader);
+    glDetachShader(pending.program, pending.fshader);
+    glDeleteShader(pending.vshader);
+    glDeleteShader(pending.fshader);
+    parg_program_cache_store(pending.key, pending.program);
 
-    return program_handle;
+    return pending.program;
 }
 
-static void gather_uniforms(parg_token ptoken, GLuint phandle)
+// Resolves the location of every active uniform into the program's slot
+// table.  The token registry reports any two names that share a token.
+static void gather_uniforms(program_info* program)
 {
-    int nuniforms;
-    glGetProgramiv(phandle, GL_ACTIVE_UNIFORMS, &nuniforms);
+    GLuint phandle = program->handle;
+    int nactive;
+    glGetProgramiv(phandle, GL_ACTIVE_UNIFORMS, &nactive);
     char uname[MAX_UNIFORM_LEN];
-    while (nuniforms--) {
+    for (int u = 0; u < nactive; u++) {
         GLint size;
         GLenum type;
-        int ret;
         glGetActiveUniform(
-            phandle, nuniforms, MAX_UNIFORM_LEN, 0, &size, &type, uname);
-        GLint loc = glGetUniformLocation(phandle, uname);
-        parg_token utoken = parg_token_from_string(uname);
-        parg_token combined_token = ptoken ^ utoken;
-        khiter_t iter = kh_put(imap, _unif_registry, combined_token, &ret);
-        kh_value(_unif_registry, iter) = loc;
+            phandle, u, MAX_UNIFORM_LEN, 0, &size, &type, uname);
+        uniform_slot_add(uniform_token(uname));
+    }
+    program->nuniforms = kh_size(_unif_registry);
+    program->uniforms =
+        calloc(program->nuniforms, sizeof(parg_uniform_state));
+    for (int slot = 0; slot < program->nuniforms; slot++) {
+        program->uniforms[slot].location = -1;
+    }
+    for (int u = 0; u < nactive; u++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(
+            phandle, u, MAX_UNIFORM_LEN, 0, &size, &type, uname);
+        int slot = uniform_slot_find(uniform_token(uname));
+        program->uniforms[slot].location =
+            glGetUniformLocation(phandle, uname);
     }
 }
 
@@ -262,45 +573,203 @@ GLuint parg_shader_attrib_get(parg_token tok)
     return kh_value(_attr_registry, iter);
 }
 
+// Returns the state of the given uniform in the current program, or null if
+// no program is bound or it has no such uniform.
+parg_uniform_state* parg_shader_uniform_state(parg_token utoken)
+{
+    if (!_current_program) {
+        return 0;
+    }
+    int slot = uniform_slot_find(utoken);
+    if (slot < 0 || slot >= _current_program->nuniforms) {
+        return 0;
+    }
+    parg_uniform_state* state = _current_program->uniforms + slot;
+    return state->location < 0 ? 0 : state;
+}
+
 GLint parg_shader_uniform_get(parg_token utoken)
 {
-    parg_token ptoken = _current_program_token;
-    parg_token combined_token = ptoken ^ utoken;
-    khiter_t iter = kh_get(imap, _unif_registry, combined_token);
-    if (iter == kh_end(_unif_registry)) {
-        return -1;
+    parg_uniform_state* state = parg_shader_uniform_state(utoken);
+    return state ? state->location : -1;
+}
+
+// Inserts the defines after the #version line, if there is one.
+static sds insert_defines(sds body, sds defines)
+{
+    char* start = body;
+    if (!strncmp(body, "#version", 8)) {
+        start = strchr(body, '\n');
+        start = start ? start + 1 : body + sdslen(body);
     }
-    return kh_value(_unif_registry, iter);
+    sds result = sdsnewlen(body, start - body);
+    result = sdscatsds(result, defines);
+    return sdscat(result, start);
 }
 
-void parg_shader_bind(parg_token tok)
+// Returns the token for the given permutation of a program, registering its
+// sources on first use.  Variant names list their flags, for example
+// "p_mesh+SHOWGRID", which keeps error messages readable.
+static parg_token variant_token(parg_token tok, uint32_t mask)
 {
-    if (!_program_registry) {
-        _program_registry = kh_init(glmap);
+    if (!mask) {
+        return tok;
     }
-    khiter_t iter = kh_get(glmap, _program_registry, tok);
-    GLuint program = 0;
+    uint64_t vkey = ((uint64_t) tok << 32) | mask;
+    khiter_t iter = kh_get(vmap, _variant_registry, vkey);
+    if (iter != kh_end(_variant_registry)) {
+        return kh_value(_variant_registry, iter);
+    }
+    const char* program_name = parg_token_to_string(tok);
+    iter = kh_get(fmap, _flag_registry, tok);
+    parg_verify(iter != kh_end(_flag_registry), "No program", program_name);
+    sdsvec flags = kh_value(_flag_registry, iter);
+    uint64_t valid = (1ull << kv_size(flags)) - 1;
+    parg_verify(!(mask & ~valid), "Bad variant mask", program_name);
+
+    sds name = sdsnew(program_name);
+    sds defines = sdsempty();
+    for (int f = 0; f < kv_size(flags); f++) {
+        if (mask & (1u << f)) {
+            name = sdscatprintf(name, "+%s", kv_A(flags, f));
+            defines = sdscatprintf(defines, "#define %s\n", kv_A(flags, f));
+        }
+    }
+    parg_token vtok = parg_token_from_string(name);
+    int ret;
+    iter = kh_get(smap, _vshader_registry, tok);
+    sds vshader_body = insert_defines(kh_value(_vshader_registry, iter),
+        defines);
+    iter = kh_get(smap, _fshader_registry, tok);
+    sds fshader_body = insert_defines(kh_value(_fshader_registry, iter),
+        defines);
+    iter = kh_put(smap, _vshader_registry, vtok, &ret);
+    kh_value(_vshader_registry, iter) = vshader_body;
+    iter = kh_put(smap, _fshader_registry, vtok, &ret);
+    kh_value(_fshader_registry, iter) = fshader_body;
+    iter = kh_put(vmap, _variant_registry, vkey, &ret);
+    kh_value(_variant_registry, iter) = vtok;
+    sdsfree(name);
+    sdsfree(defines);
+    return vtok;
+}
+
+static program_info* register_program(parg_token tok, GLuint handle)
+{
+    program_info* program = calloc(1, sizeof(program_info));
+    program->handle = handle;
+    parg_uniformblock_link(handle);
+    gather_uniforms(program);
     int ret;
+    khiter_t iter = kh_put(glmap, _program_registry, tok, &ret);
+    kh_value(_program_registry, iter) = program;
+    return program;
+}
+
+// Submits the given program, or every loaded program if the token is zero,
+// for compilation.  Programs that are already linked or pending are skipped.
+void parg_shader_prewarm(parg_token tok)
+{
+    for (khiter_t iter = kh_begin(_vshader_registry);
+        iter != kh_end(_vshader_registry); ++iter) {
+        if (!kh_exist(_vshader_registry, iter)) {
+            continue;
+        }
+        parg_token ptoken = kh_key(_vshader_registry, iter);
+        if ((tok && ptoken != tok) ||
+            kh_get(glmap, _program_registry, ptoken) !=
+                kh_end(_program_registry) ||
+            kh_get(pmap, _pending_registry, ptoken) !=
+                kh_end(_pending_registry)) {
+            continue;
+        }
+        int ret;
+        khiter_t pending = kh_put(pmap, _pending_registry, ptoken, &ret);
+        kh_value(_pending_registry, pending) = start_program(ptoken);
+    }
+    parg_shader_prewarm_poll();
+}
+
+// Registers every prewarmed program that has finished, without blocking when
+// parallel compilation is available.  Returns the number still pending.
+int parg_shader_prewarm_poll()
+{
+    for (khiter_t iter = kh_begin(_pending_registry);
+        iter != kh_end(_pending_registry); ++iter) {
+        if (!kh_exist(_pending_registry, iter)) {
+            continue;
+        }
+        pending_program pending = kh_value(_pending_registry, iter);
+        if (program_ready(&pending)) {
+            parg_token ptoken = kh_key(_pending_registry, iter);
+            register_program(ptoken, finish_program(ptoken, pending));
+            kh_del(pmap, _pending_registry, iter);
+        }
+    }
+    return kh_size(_pending_registry);
+}
+
+// Binds the permutation of a program whose flags are set in the mask, where
+// bit N corresponds to the Nth name in the @program flag list.
+void parg_shader_bind_variant(parg_token tok, uint32_t mask)
+{
+    tok = variant_token(tok, mask);
+    khiter_t iter = kh_get(glmap, _program_registry, tok);
+    program_info* program;
     if (iter == kh_end(_program_registry)) {
-        program = compile_program(tok);
-        iter = kh_put(glmap, _program_registry, tok, &ret);
-        kh_value(_program_registry, iter) = program;
-        gather_uniforms(tok, program);
+        pending_program pending;
+        iter = kh_get(pmap, _pending_registry, tok);
+        if (iter != kh_end(_pending_registry)) {
+            pending = kh_value(_pending_registry, iter);
+            kh_del(pmap, _pending_registry, iter);
+        } else {
+            pending = start_program(tok);
+        }
+        program = register_program(tok, finish_program(tok, pending));
     } else {
         program = kh_value(_program_registry, iter);
     }
-    parg_verify(program, "No program", parg_token_to_string(tok));
-    glUseProgram(program);
+    parg_verify(program->handle, "No program", parg_token_to_string(tok));
+    parg_state_use_program(program->handle);
     _current_program = program;
-    _current_program_token = tok;
+    parg_uniformblock_apply();
 }
 
-void parg_shader_free(parg_token tok)
+void parg_shader_bind(parg_token tok) { parg_shader_bind_variant(tok, 0); }
+
+static void free_program(parg_token tok)
 {
-    khiter_t iter = kh_get(glmap, _program_registry, tok);
+    khiter_t iter = kh_get(pmap, _pending_registry, tok);
+    if (iter != kh_end(_pending_registry)) {
+        pending_program pending = kh_value(_pending_registry, iter);
+        glDeleteShader(pending.vshader);
+        glDeleteShader(pending.fshader);
+        glDeleteProgram(pending.program);
+        kh_del(pmap, _pending_registry, iter);
+    }
+    iter = kh_get(glmap, _program_registry, tok);
     if (iter != kh_end(_program_registry)) {
-        GLuint program = kh_value(_program_registry, iter);
-        glDeleteProgram(program);
+        program_info* program = kh_value(_program_registry, iter);
+        if (program == _current_program) {
+            _current_program = 0;
+        }
+        parg_state_forget_program(program->handle);
+        glDeleteProgram(program->handle);
+        free(program->uniforms);
+        free(program);
         kh_del(glmap, _program_registry, iter);
     }
 }
+
+// Frees the program along with all of its variants.
+void parg_shader_free(parg_token tok)
+{
+    free_program(tok);
+    for (khiter_t iter = kh_begin(_variant_registry);
+        iter != kh_end(_variant_registry); ++iter) {
+        if (kh_exist(_variant_registry, iter) &&
+            kh_key(_variant_registry, iter) >> 32 == tok) {
+            free_program(kh_value(_variant_registry, iter));
+        }
+    }
+}
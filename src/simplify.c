@@ -0,0 +1,399 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "internal.h"
+
+// Edge-collapse simplification driven by the quadric error metric from
+// Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics".
+// Collapses only move a vertex onto one of its neighbors, so the vertex
+// buffer is left untouched and every LOD can share it.  Vertices that lie on
+// an open border or on a UV / normal seam (i.e. share their position with
+// another vertex) are never moved, which keeps seams watertight.
+
+typedef struct {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2, w;
+} quadric;
+
+typedef struct {
+    uint32_t v0;
+    uint32_t v1;
+    float cost;
+} collapse;
+
+static void quadric_add(quadric* dst, quadric const* src)
+{
+    double* d = &dst->a2;
+    double const* s = &src->a2;
+    for (int i = 0; i < 11; i++) {
+        d[i] += s[i];
+    }
+}
+
+static void quadric_from_triangle(
+    quadric* q, Vector3 p0, Vector3 p1, Vector3 p2)
+{
+    Vector3 n = V3Cross(V3Sub(p1, p0), V3Sub(p2, p0));
+    double len = V3Length(n);
+    memset(q, 0, sizeof(quadric));
+    if (len == 0) {
+        return;
+    }
+    double a = n.x / len, b = n.y / len, c = n.z / len;
+    double d = -(a * p0.x + b * p0.y + c * p0.z);
+    double w = len * 0.5;
+    q->a2 = a * a * w;
+    q->ab = a * b * w;
+    q->ac = a * c * w;
+    q->ad = a * d * w;
+    q->b2 = b * b * w;
+    q->bc = b * c * w;
+    q->bd = b * d * w;
+    q->c2 = c * c * w;
+    q->cd = c * d * w;
+    q->d2 = d * d * w;
+    q->w = w;
+}
+
+static double quadric_eval(quadric const* q, Vector3 p)
+{
+    double x = p.x, y = p.y, z = p.z;
+    double r = q->a2 * x * x + 2 * q->ab * x * y + 2 * q->ac * x * z +
+        2 * q->ad * x + q->b2 * y * y + 2 * q->bc * y * z + 2 * q->bd * y +
+        q->c2 * z * z + 2 * q->cd * z + q->d2;
+    return r < 0 ? 0 : r;
+}
+
+static Vector3 const* _sortpos = 0;
+
+static int cmp_position(void const* a, void const* b)
+{
+    Vector3 const* pos = _sortpos;
+    Vector3 pa = pos[*(uint32_t const*) a];
+    Vector3 pb = pos[*(uint32_t const*) b];
+    if (pa.x != pb.x) {
+        return pa.x < pb.x ? -1 : 1;
+    }
+    if (pa.y != pb.y) {
+        return pa.y < pb.y ? -1 : 1;
+    }
+    if (pa.z != pb.z) {
+        return pa.z < pb.z ? -1 : 1;
+    }
+    return 0;
+}
+
+static int cmp_edge(void const* a, void const* b)
+{
+    uint64_t ea = *(uint64_t const*) a;
+    uint64_t eb = *(uint64_t const*) b;
+    return ea < eb ? -1 : (ea > eb ? 1 : 0);
+}
+
+static int cmp_collapse(void const* a, void const* b)
+{
+    float ca = ((collapse const*) a)->cost;
+    float cb = ((collapse const*) b)->cost;
+    return ca < cb ? -1 : (ca > cb ? 1 : 0);
+}
+
+// Flags seam vertices (those that share a position with another vertex) and
+// border vertices (those on an edge that is not shared by exactly two
+// triangles, determined in position space so that seams are not borders).
+static char* classify_vertices(
+    uint32_t const* indices, int ntris, int nverts, Vector3 const* pos)
+{
+    char* locked = calloc(nverts, 1);
+    uint32_t* order = malloc(nverts * sizeof(uint32_t));
+    uint32_t* canonical = malloc(nverts * sizeof(uint32_t));
+    for (int v = 0; v < nverts; v++) {
+        order[v] = v;
+    }
+    _sortpos = pos;
+    qsort(order, nverts, sizeof(uint32_t), cmp_position);
+    for (int i = 0; i < nverts;) {
+        int j = i + 1;
+        while (j < nverts && !cmp_position(&order[i], &order[j])) {
+            j++;
+        }
+        for (int k = i; k < j; k++) {
+            canonical[order[k]] = order[i];
+            locked[order[k]] = j - i > 1;
+        }
+        i = j;
+    }
+    uint64_t* edges = malloc(ntris * 3 * sizeof(uint64_t));
+    for (int i = 0; i < ntris * 3; i++) {
+        uint64_t a = canonical[indices[i]];
+        uint64_t b = canonical[indices[i - i % 3 + (i + 1) % 3]];
+        edges[i] = a < b ? (a << 32) | b : (b << 32) | a;
+    }
+    qsort(edges, ntris * 3, sizeof(uint64_t), cmp_edge);
+    for (int i = 0; i < ntris * 3;) {
+        int j = i + 1;
+        while (j < ntris * 3 && edges[j] == edges[i]) {
+            j++;
+        }
+        if (j - i != 2) {
+            locked[edges[i] >> 32] = 1;
+            locked[edges[i] & 0xffffffff] = 1;
+        }
+        i = j;
+    }
+
+    // Propagate border flags from canonical vertices to their duplicates.
+    for (int v = 0; v < nverts; v++) {
+        locked[v] |= locked[canonical[v]];
+    }
+    free(edges);
+    free(order);
+    free(canonical);
+    return locked;
+}
+
+static int collapse_flips(uint32_t v0, uint32_t v1, uint32_t const* indices,
+    int const* offsets, int const* adjacency, Vector3 const* pos)
+{
+    for (int i = offsets[v0]; i < offsets[v0 + 1]; i++) {
+        uint32_t const* tri = indices + adjacency[i] * 3;
+        if (tri[0] == v1 || tri[1] == v1 || tri[2] == v1) {
+            continue;
+        }
+        Vector3 p[3], q[3];
+        for (int c = 0; c < 3; c++) {
+            p[c] = pos[tri[c]];
+            q[c] = tri[c] == v0 ? pos[v1] : p[c];
+        }
+        Vector3 n0 = V3Cross(V3Sub(p[1], p[0]), V3Sub(p[2], p[0]));
+        Vector3 n1 = V3Cross(V3Sub(q[1], q[0]), V3Sub(q[2], q[0]));
+        if (V3Dot(n0, n1) <= 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Simplifies the given index list in place and returns the new triangle
+// count.  The error is relative to the diagonal of the bounding box.
+static int simplify_indices(uint32_t* indices, int ntris, int nverts,
+    float const* coords, int target, float maxerror, float* result)
+{
+    Vector3 const* src = (Vector3 const*) coords;
+    Vector3 lo = {INFINITY, INFINITY, INFINITY};
+    Vector3 hi = {-INFINITY, -INFINITY, -INFINITY};
+    for (int v = 0; v < nverts; v++) {
+        lo = V3MinPerElem(lo, src[v]);
+        hi = V3MaxPerElem(hi, src[v]);
+    }
+    float diagonal = V3Length(V3Sub(hi, lo));
+    float scale = diagonal > 0 ? 1.0f / diagonal : 1.0f;
+    Vector3* pos = malloc(nverts * sizeof(Vector3));
+    for (int v = 0; v < nverts; v++) {
+        pos[v] = V3ScalarMul(V3Sub(src[v], lo), scale);
+    }
+
+    char* locked = classify_vertices(indices, ntris, nverts, pos);
+    quadric* quadrics = calloc(nverts, sizeof(quadric));
+    for (int t = 0; t < ntris; t++) {
+        uint32_t const* tri = indices + t * 3;
+        quadric q;
+        quadric_from_triangle(&q, pos[tri[0]], pos[tri[1]], pos[tri[2]]);
+        for (int c = 0; c < 3; c++) {
+            quadric_add(&quadrics[tri[c]], &q);
+        }
+    }
+
+    int* offsets = malloc((nverts + 1) * sizeof(int));
+    int* adjacency = malloc(ntris * 3 * sizeof(int));
+    uint32_t* remap = malloc(nverts * sizeof(uint32_t));
+    char* passlock = malloc(nverts);
+    collapse* collapses = malloc(ntris * 6 * sizeof(collapse));
+    double limit = (double) maxerror * maxerror;
+    double worst = 0;
+
+    while (ntris > target) {
+
+        // Build the vertex-to-triangle adjacency for the current indices.
+        memset(offsets, 0, (nverts + 1) * sizeof(int));
+        for (int i = 0; i < ntris * 3; i++) {
+            offsets[indices[i] + 1]++;
+        }
+        for (int v = 0; v < nverts; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        for (int i = 0; i < ntris * 3; i++) {
+            adjacency[offsets[indices[i]]++] = i / 3;
+        }
+        for (int v = nverts; v > 0; v--) {
+            offsets[v] = offsets[v - 1];
+        }
+        offsets[0] = 0;
+
+        // Gather and sort candidate collapses by their quadric error.
+        int ncollapses = 0;
+        for (int i = 0; i < ntris * 3; i++) {
+            uint32_t a = indices[i];
+            uint32_t b = indices[i - i % 3 + (i + 1) % 3];
+            for (int dir = 0; dir < 2; dir++) {
+                uint32_t v0 = dir ? b : a;
+                uint32_t v1 = dir ? a : b;
+                if (locked[v0]) {
+                    continue;
+                }
+                quadric q = quadrics[v0];
+                quadric_add(&q, &quadrics[v1]);
+                double cost = q.w > 0 ? quadric_eval(&q, pos[v1]) / q.w : 0;
+                if (cost <= limit) {
+                    collapses[ncollapses++] = (collapse){v0, v1, cost};
+                }
+            }
+        }
+        if (ncollapses == 0) {
+            break;
+        }
+        qsort(collapses, ncollapses, sizeof(collapse), cmp_collapse);
+
+        // Apply as many independent collapses as possible in this pass.
+        for (int v = 0; v < nverts; v++) {
+            remap[v] = v;
+        }
+        memset(passlock, 0, nverts);
+        int removed = 0;
+        for (int i = 0; i < ncollapses && ntris - removed > target; i++) {
+            uint32_t v0 = collapses[i].v0;
+            uint32_t v1 = collapses[i].v1;
+            if (passlock[v0] || passlock[v1] ||
+                collapse_flips(v0, v1, indices, offsets, adjacency, pos)) {
+                continue;
+            }
+            remap[v0] = v1;
+            quadric_add(&quadrics[v1], &quadrics[v0]);
+            worst = PARG_MAX(worst, collapses[i].cost);
+            for (int j = offsets[v0]; j < offsets[v0 + 1]; j++) {
+                uint32_t const* tri = indices + adjacency[j] * 3;
+                removed += tri[0] == v1 || tri[1] == v1 || tri[2] == v1;
+                passlock[tri[0]] = passlock[tri[1]] = passlock[tri[2]] = 1;
+            }
+        }
+        if (removed == 0) {
+            break;
+        }
+
+        // Remap the indices and discard degenerate triangles.
+        int ndst = 0;
+        for (int t = 0; t < ntris; t++) {
+            uint32_t a = remap[indices[t * 3]];
+            uint32_t b = remap[indices[t * 3 + 1]];
+            uint32_t c = remap[indices[t * 3 + 2]];
+            if (a != b && b != c && a != c) {
+                indices[ndst * 3] = a;
+                indices[ndst * 3 + 1] = b;
+                indices[ndst * 3 + 2] = c;
+                ndst++;
+            }
+        }
+        ntris = ndst;
+    }
+
+    free(pos);
+    free(locked);
+    free(quadrics);
+    free(offsets);
+    free(adjacency);
+    free(remap);
+    free(passlock);
+    free(collapses);
+    *result = sqrt(worst);
+    return ntris;
+}
+
+static float const* lock_float3_coords(parg_mesh* mesh)
+{
+    parg_assert(mesh->coords, "Non-interleaved mesh required");
+    parg_assert(!parg_buffer_gpu_check(mesh->coords), "CPU mesh required");
+    parg_vertex_attrib const* attrib = &mesh->layout[PARG_MESH_COORD];
+    parg_assert(attrib->ncomps == 3 && attrib->type == PARG_FLOAT,
+        "Simplification requires float3 coordinates");
+    return parg_buffer_lock(mesh->coords, PARG_READ);
+}
+
+float parg_mesh_simplify(parg_mesh* mesh, float target_ratio, float max_error)
+{
+    float const* coords = lock_float3_coords(mesh);
+    int nverts = parg_mesh_nverts(mesh);
+    uint32_t* indices = parg_mesh_read_indices(mesh);
+    int target = mesh->ntriangles * target_ratio;
+    float error;
+    int ntris = simplify_indices(indices, mesh->ntriangles, nverts, coords,
+        target, max_error, &error);
+    parg_buffer_unlock(mesh->coords);
+    parg_mesh_write_indices(mesh, indices, ntris);
+    free(indices);
+    return error;
+}
+
+// Each level is simplified from the full-resolution mesh so that its error is
+// measured against the original surface.  Level 0 is the original, and the
+// levels are concatenated in one index buffer.  Generation stops early when a
+// level would not remove at least a tenth of the previous level's triangles.
+int parg_mesh_lod_chain(parg_mesh* mesh, int maxlevels, float ratio)
+{
+    float const* coords = lock_float3_coords(mesh);
+    int nverts = parg_mesh_nverts(mesh);
+    int ntris = mesh->ntriangles;
+    uint32_t* original = parg_mesh_read_indices(mesh);
+    uint32_t* chain = malloc(ntris * 3 * sizeof(uint32_t) * maxlevels);
+    uint32_t* scratch = malloc(ntris * 3 * sizeof(uint32_t));
+    parg_mesh_lod* lods = malloc(maxlevels * sizeof(parg_mesh_lod));
+    memcpy(chain, original, ntris * 3 * sizeof(uint32_t));
+    lods[0] = (parg_mesh_lod){0, ntris, 0};
+    int nlevels = 1, total = ntris;
+    float target = ntris;
+    while (nlevels < maxlevels) {
+        target *= ratio;
+        memcpy(scratch, original, ntris * 3 * sizeof(uint32_t));
+        float error;
+        int count = simplify_indices(
+            scratch, ntris, nverts, coords, target, INFINITY, &error);
+        if (count == 0 || count > lods[nlevels - 1].ntriangles * 0.9f) {
+            break;
+        }
+        memcpy(chain + total * 3, scratch, count * 3 * sizeof(uint32_t));
+        lods[nlevels++] = (parg_mesh_lod){total, count, error};
+        total += count;
+    }
+    parg_buffer_unlock(mesh->coords);
+    parg_mesh_write_indices(mesh, chain, total);
+    mesh->ntriangles = ntris;
+    mesh->lods = lods;
+    mesh->nlods = nlevels;
+    free(original);
+    free(chain);
+    free(scratch);
+    return nlevels;
+}
+
+// Picks the coarsest level whose error, projected onto the screen, stays
+// within the given number of pixels.  The screen size is the projected
+// length of the mesh's bounding box diagonal, in pixels.
+int parg_mesh_lod_select(parg_mesh* mesh, float screen_size, float pixel_error)
+{
+    int level = 0;
+    for (int i = 1; i < mesh->nlods; i++) {
+        if (mesh->lods[i].error * screen_size <= pixel_error) {
+            level = i;
+        }
+    }
+    return level;
+}
+
+void parg_mesh_lod_range(parg_mesh* mesh, int level, int* start, int* ntris)
+{
+    if (level >= mesh->nlods) {
+        *start = 0;
+        *ntris = mesh->ntriangles;
+        return;
+    }
+    *start = mesh->lods[level].start;
+    *ntris = mesh->lods[level].ntriangles;
+}
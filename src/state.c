@@ -1,8 +1,244 @@
 #include <parg.h>
+#include <string.h>
+#include "internal.h"
 #include "pargl.h"
 
+// Shadow copies of the GL state that changes most often.  Requests that
+// match the copy are dropped, and each value is stored plus one so that zero
+// means unknown, which is the state at startup and after invalidation.  In
+// validation mode, every dropped request is first checked against the real
+// GL state, which catches code that changes it behind the tracker's back.
+// Deleted objects must be reported since GL recycles their names.
+
+#define MAX_UNITS 16
+
+#if defined(GL_PROGRAM_POINT_SIZE)
+#define POINT_SIZE_CAP GL_PROGRAM_POINT_SIZE
+#elif defined(GL_VERTEX_PROGRAM_POINT_SIZE)
+#define POINT_SIZE_CAP GL_VERTEX_PROGRAM_POINT_SIZE
+#endif
+
+static const struct {
+    GLenum cap;
+    const char* name;
+} CAPS[] = {
+    {GL_CULL_FACE, "GL_CULL_FACE"},
+    {GL_DEPTH_TEST, "GL_DEPTH_TEST"},
+    {GL_BLEND, "GL_BLEND"},
+#ifndef EMSCRIPTEN
+    {GL_POLYGON_OFFSET_LINE, "GL_POLYGON_OFFSET_LINE"},
+#endif
+#ifdef POINT_SIZE_CAP
+    {POINT_SIZE_CAP, "POINT_SIZE"},
+#endif
+};
+
+#define NCAPS (sizeof(CAPS) / sizeof(CAPS[0]))
+
+static struct {
+    GLuint caps[NCAPS];
+    GLuint blend_src;
+    GLuint blend_dst;
+    GLuint program;
+    GLuint unit;
+    GLuint textures[MAX_UNITS];
+    GLuint array_buffer;
+    GLuint element_buffer;
+    GLuint framebuffer;
+    GLuint vertex_array;
+} _shadow;
+
+static int _validate = 0;
+static int _issued = 0;
+static int _filtered = 0;
+
 int _parg_depthtest = 0;
 
+static void check_integer(GLenum query, GLuint expected, const char* name)
+{
+    GLint actual = 0;
+    glGetIntegerv(query, &actual);
+    parg_verify(actual == expected, "GL state mismatch", name);
+}
+
+// Returns true if the call must be issued, in which case the shadow is
+// updated to the new value.
+static int changed(GLuint* shadow, GLuint value, GLenum query,
+    const char* name)
+{
+    if (*shadow != value + 1) {
+        *shadow = value + 1;
+        _issued++;
+        return 1;
+    }
+    if (_validate) {
+        check_integer(query, value, name);
+    }
+    _filtered++;
+    return 0;
+}
+
+void parg_state_enable(GLenum cap, int enabled)
+{
+    int c = 0;
+    while (c < NCAPS && CAPS[c].cap != cap) {
+        c++;
+    }
+    enabled = enabled ? 1 : 0;
+    if (c < NCAPS && _shadow.caps[c] == enabled + 1) {
+        if (_validate) {
+            parg_verify(glIsEnabled(cap) == enabled, "GL state mismatch",
+                CAPS[c].name);
+        }
+        _filtered++;
+        return;
+    }
+    if (c < NCAPS) {
+        _shadow.caps[c] = enabled + 1;
+    }
+    _issued++;
+    (enabled ? glEnable : glDisable)(cap);
+}
+
+void parg_state_blendfunc(GLenum src, GLenum dst)
+{
+    if (_shadow.blend_src == src + 1 && _shadow.blend_dst == dst + 1) {
+        if (_validate) {
+            check_integer(GL_BLEND_SRC_RGB, src, "GL_BLEND_SRC_RGB");
+            check_integer(GL_BLEND_DST_RGB, dst, "GL_BLEND_DST_RGB");
+        }
+        _filtered++;
+        return;
+    }
+    _shadow.blend_src = src + 1;
+    _shadow.blend_dst = dst + 1;
+    _issued++;
+    glBlendFunc(src, dst);
+}
+
+void parg_state_use_program(GLuint program)
+{
+    if (changed(&_shadow.program, program, GL_CURRENT_PROGRAM,
+        "GL_CURRENT_PROGRAM")) {
+        glUseProgram(program);
+    }
+}
+
+static void check_texture(int unit, GLuint texture)
+{
+    GLint active = GL_TEXTURE0;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    check_integer(GL_TEXTURE_BINDING_2D, texture, "GL_TEXTURE_BINDING_2D");
+    glActiveTexture(active);
+}
+
+// The active unit is switched only when the binding actually changes.  Each
+// call counts as one issued or filtered event, including any unit switch.
+void parg_state_bind_texture(int unit, GLuint texture)
+{
+    parg_assert(unit >= 0 && unit < MAX_UNITS, "Bad texture unit");
+    GLuint* shadow = _shadow.textures + unit;
+    if (*shadow == texture + 1) {
+        if (_validate) {
+            check_texture(unit, texture);
+        }
+        _filtered++;
+        return;
+    }
+    *shadow = texture + 1;
+    _issued++;
+    if (_shadow.unit != GL_TEXTURE0 + unit + 1) {
+        _shadow.unit = GL_TEXTURE0 + unit + 1;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void parg_state_bind_buffer(GLenum target, GLuint buffer)
+{
+    int issue = target == GL_ARRAY_BUFFER ?
+        changed(&_shadow.array_buffer, buffer, GL_ARRAY_BUFFER_BINDING,
+            "GL_ARRAY_BUFFER_BINDING") :
+        changed(&_shadow.element_buffer, buffer,
+            GL_ELEMENT_ARRAY_BUFFER_BINDING, "GL_ELEMENT_ARRAY_BUFFER_BINDING");
+    if (issue) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void parg_state_bind_framebuffer(GLuint framebuffer)
+{
+    if (changed(&_shadow.framebuffer, framebuffer, GL_FRAMEBUFFER_BINDING,
+        "GL_FRAMEBUFFER_BINDING")) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+}
+
+// The element buffer binding belongs to the vertex array object, so it
+// becomes unknown whenever the VAO changes.
+void parg_state_bind_vertex_array(GLuint vao)
+{
+#if !EMSCRIPTEN
+    if (changed(&_shadow.vertex_array, vao, GL_VERTEX_ARRAY_BINDING,
+        "GL_VERTEX_ARRAY_BINDING")) {
+        glBindVertexArray(vao);
+        _shadow.element_buffer = 0;
+    }
+#endif
+}
+
+static void forget(GLuint* shadow, GLuint name)
+{
+    if (*shadow == name + 1) {
+        *shadow = 0;
+    }
+}
+
+void parg_state_forget_texture(GLuint texture)
+{
+    for (int u = 0; u < MAX_UNITS; u++) {
+        forget(_shadow.textures + u, texture);
+    }
+}
+
+void parg_state_forget_buffer(GLuint buffer)
+{
+    forget(&_shadow.array_buffer, buffer);
+    forget(&_shadow.element_buffer, buffer);
+}
+
+void parg_state_forget_program(GLuint program)
+{
+    forget(&_shadow.program, program);
+}
+
+void parg_state_forget_framebuffer(GLuint framebuffer)
+{
+    forget(&_shadow.framebuffer, framebuffer);
+}
+
+void parg_state_forget_vertex_array(GLuint vao)
+{
+    if (_shadow.vertex_array == vao + 1) {
+        _shadow.vertex_array = 0;
+        _shadow.element_buffer = 0;
+    }
+}
+
+// Must be called after GL state is changed outside of parg.
+void parg_state_invalidate() { memset(&_shadow, 0, sizeof(_shadow)); }
+
+void parg_state_validate(int enabled) { _validate = enabled; }
+
+void parg_state_counters(int* issued, int* filtered)
+{
+    *issued = _issued;
+    *filtered = _filtered;
+}
+
+void parg_state_reset_counters() { _issued = _filtered = 0; }
+
 void parg_state_clearcolor(Vector4 color)
 {
     glClearColor(color.x, color.y, color.z, color.w);
@@ -10,21 +246,49 @@ void parg_state_clearcolor(Vector4 color)
 
 void parg_state_cullfaces(int enabled)
 {
-    (enabled ? glEnable : glDisable)(GL_CULL_FACE);
+    parg_state_enable(GL_CULL_FACE, enabled);
 }
 
 void parg_state_depthtest(int enabled)
 {
-    (enabled ? glEnable : glDisable)(GL_DEPTH_TEST);
+    parg_state_enable(GL_DEPTH_TEST, enabled);
     _parg_depthtest = enabled;
 }
 
 void parg_state_blending(int enabled)
 {
     if (enabled == 1) {
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        parg_state_blendfunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     } else if (enabled == 2) {
-        glBlendFunc(GL_ONE, GL_ONE);
+        parg_state_blendfunc(GL_ONE, GL_ONE);
+    }
+    parg_state_enable(GL_BLEND, enabled);
+}
+
+// Legacy and ES contexts list extensions in one string, while core profiles
+// only provide them one at a time.
+int parg_state_has_extension(const char* name)
+{
+    const char* exts = (const char*) glGetString(GL_EXTENSIONS);
+    if (exts) {
+        int len = strlen(name);
+        while ((exts = strstr(exts, name))) {
+            if (exts[len] == ' ' || exts[len] == 0) {
+                return 1;
+            }
+            exts += len;
+        }
+        return 0;
+    }
+#if !EMSCRIPTEN
+    GLint nexts = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &nexts);
+    for (int i = 0; i < nexts; i++) {
+        const char* ext = (const char*) glGetStringi(GL_EXTENSIONS, i);
+        if (ext && !strcmp(ext, name)) {
+            return 1;
+        }
     }
-    (enabled ? glEnable : glDisable)(GL_BLEND);
+#endif
+    return 0;
 }
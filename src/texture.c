@@ -21,7 +21,7 @@ parg_texture* parg_texture_from_asset(parg_token id)
     int ncomps = *rawdata++;
     assert(ncomps == 4);
     glGenTextures(1, &tex->handle);
-    glBindTexture(GL_TEXTURE_2D, tex->handle);
+    parg_state_bind_texture(0, tex->handle);
     parg_texture_fliprows(rawdata, tex->width * ncomps, tex->height);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex->width, tex->height, 0, GL_RGBA,
         GL_UNSIGNED_BYTE, rawdata);
@@ -46,7 +46,7 @@ parg_texture* parg_texture_from_buffer(parg_buffer* buf)
     tex->width = dims[0];
     tex->height = dims[1];
     glGenTextures(1, &tex->handle);
-    glBindTexture(GL_TEXTURE_2D, tex->handle);
+    parg_state_bind_texture(0, tex->handle);
     parg_texture_fliprows(decoded, tex->width * 4, tex->height);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex->width, tex->height, 0, GL_RGBA,
         GL_UNSIGNED_BYTE, decoded);
@@ -66,7 +66,7 @@ parg_texture* parg_texture_from_asset_linear(parg_token id)
     int ncomps = *rawdata++;
     assert(ncomps == 4);
     glGenTextures(1, &tex->handle);
-    glBindTexture(GL_TEXTURE_2D, tex->handle);
+    parg_state_bind_texture(0, tex->handle);
     parg_texture_fliprows(rawdata, tex->width * ncomps, tex->height);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex->width, tex->height, 0, GL_RGBA,
         GL_UNSIGNED_BYTE, rawdata);
@@ -80,8 +80,7 @@ parg_texture* parg_texture_from_asset_linear(parg_token id)
 
 void parg_texture_bind(parg_texture* tex, int stage)
 {
-    glActiveTexture(GL_TEXTURE0 + stage);
-    glBindTexture(GL_TEXTURE_2D, tex->handle);
+    parg_state_bind_texture(stage, tex->handle);
 }
 
 void parg_texture_info(parg_texture* tex, int* width, int* height)
@@ -93,6 +92,7 @@ void parg_texture_info(parg_texture* tex, int* width, int* height)
 void parg_texture_free(parg_texture* tex)
 {
     if (tex) {
+        parg_state_forget_texture(tex->handle);
         glDeleteTextures(1, &tex->handle);
         free(tex);
     }
@@ -122,7 +122,7 @@ parg_texture* parg_texture_from_u8(
     tex->height = height;
     char* rawdata = parg_buffer_lock(buf, PARG_READ);
     glGenTextures(1, &tex->handle);
-    glBindTexture(GL_TEXTURE_2D, tex->handle);
+    parg_state_bind_texture(0, tex->handle);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex->width, tex->height, 0, GL_RGBA,
         GL_UNSIGNED_BYTE, rawdata + byteoffset);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -142,7 +142,7 @@ parg_texture* parg_texture_from_fp32(
     tex->height = height;
     char* rawdata = parg_buffer_lock(buf, PARG_READ);
     glGenTextures(1, &tex->handle);
-    glBindTexture(GL_TEXTURE_2D, tex->handle);
+    parg_state_bind_texture(0, tex->handle);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, tex->width, tex->height, 0,
         GL_ALPHA, GL_FLOAT, rawdata + byteoffset);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -0,0 +1,80 @@
+#include <parg.h>
+#include "internal.h"
+
+#define MAX_THREADS 16
+
+#if EMSCRIPTEN
+
+void parg_parallel_for(int count, int grain, parg_range_fn fn, void* userdata)
+{
+    if (count > 0) {
+        fn(0, count, userdata);
+    }
+}
+
+int parg_thread_count() { return 1; }
+
+#else
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+    int begin;
+    int end;
+    parg_range_fn fn;
+    void* userdata;
+    pthread_t thread;
+    int started;
+} range_task;
+
+static void* run_task(void* arg)
+{
+    range_task* task = arg;
+    task->fn(task->begin, task->end, task->userdata);
+    return 0;
+}
+
+int parg_thread_count()
+{
+    long ncores = sysconf(_SC_NPROCESSORS_ONLN);
+    return PARG_CLAMP(ncores, 1, MAX_THREADS);
+}
+
+// Splits [0, count) into contiguous ranges, one per core, and runs them
+// concurrently.  The calling thread executes the first range.  Jobs with
+// fewer than two grains of work run serially on the calling thread.
+void parg_parallel_for(int count, int grain, parg_range_fn fn, void* userdata)
+{
+    if (count <= 0) {
+        return;
+    }
+    int nthreads = parg_thread_count();
+    nthreads = PARG_MIN(nthreads, count / PARG_MAX(grain, 1));
+    if (nthreads < 2) {
+        fn(0, count, userdata);
+        return;
+    }
+    range_task tasks[MAX_THREADS];
+    for (int i = 0; i < nthreads; i++) {
+        tasks[i].begin = (long) count * i / nthreads;
+        tasks[i].end = (long) count * (i + 1) / nthreads;
+        tasks[i].fn = fn;
+        tasks[i].userdata = userdata;
+    }
+    for (int i = 1; i < nthreads; i++) {
+        tasks[i].started =
+            !pthread_create(&tasks[i].thread, 0, run_task, &tasks[i]);
+        if (!tasks[i].started) {
+            run_task(&tasks[i]);
+        }
+    }
+    run_task(&tasks[0]);
+    for (int i = 1; i < nthreads; i++) {
+        if (tasks[i].started) {
+            pthread_join(tasks[i].thread, 0);
+        }
+    }
+}
+
+#endif
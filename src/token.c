@@ -1,34 +1,101 @@
 #include <parg.h>
+#include <stdlib.h>
+#include <string.h>
 #include "internal.h"
 #include "khash.h"
 
 // Mapping from tokens to C strings.
 // There's no need for a mapping from C strings to tokens because of math.
-KHASH_MAP_INIT_INT(parstr, sds)
+// Each string is registered once.  Literals from PARG_TOKEN_DEFINE are
+// referenced in place, and other strings are copied into an arena that is
+// never freed, so the registry never leaks or duplicates strings.  Two
+// different strings with the same hash are reported as a collision.
+KHASH_MAP_INIT_INT(parstr, const char*)
+
+#define ARENA_BLOCK_SIZE 4096
+
+typedef struct arena_block_s {
+    struct arena_block_s* next;
+    int used;
+    int capacity;
+    char data[];
+} arena_block;
 
 static khash_t(parstr)* _token_registry = 0;
+static arena_block* _token_arena = 0;
 
-sds parg_token_to_sds(parg_token token)
+static const char* arena_strdup(const char* cstring)
 {
-    parg_assert(_token_registry, "Uninitialized token registry");
-    khiter_t iter = kh_get(parstr, _token_registry, token);
-    parg_assert(iter != kh_end(_token_registry), "Unknown token");
-    return kh_value(_token_registry, iter);
+    int nbytes = strlen(cstring) + 1;
+    arena_block* block = _token_arena;
+    if (!block || block->used + nbytes > block->capacity) {
+        int capacity = PARG_MAX(nbytes, ARENA_BLOCK_SIZE);
+        block = malloc(sizeof(arena_block) + capacity);
+        block->next = _token_arena;
+        block->used = 0;
+        block->capacity = capacity;
+        _token_arena = block;
+    }
+    char* dst = block->data + block->used;
+    memcpy(dst, cstring, nbytes);
+    block->used += nbytes;
+    return dst;
 }
 
-const char* parg_token_to_string(parg_token token)
+// Checks once that the compile-time hash agrees with the run-time hash,
+// rather than rehashing every literal.  Define PARG_TOKEN_DEBUG to check each
+// literal as it is interned.
+static void self_test()
 {
-    return parg_token_to_sds(token);
+    static const char literal[] = "parg_token_self_test";
+    parg_assert(PARG_TOKEN_HASH(literal) == kh_str_hash_func(literal),
+        "Token hash mismatch");
 }
 
-parg_token parg_token_from_string(const char* cstring)
+// Returns the registered string, or null if the token is new, in which case
+// the caller must fill in the slot.
+static const char** intern_slot(parg_token token, const char* cstring)
 {
-    parg_token token = kh_str_hash_func(cstring);
     if (!_token_registry) {
         _token_registry = kh_init(parstr);
+        self_test();
     }
     int ret;
-    int iter = kh_put(parstr, _token_registry, token, &ret);
-    kh_value(_token_registry, iter) = sdsnew(cstring);
+    khiter_t iter = kh_put(parstr, _token_registry, token, &ret);
+    const char** slot = &kh_value(_token_registry, iter);
+    if (ret == 0) {
+        parg_verify(!strcmp(*slot, cstring), "Token collision", cstring);
+        return 0;
+    }
+    return slot;
+}
+
+const char* parg_token_to_string(parg_token token)
+{
+    parg_assert(_token_registry, "Uninitialized token registry");
+    khiter_t iter = kh_get(parstr, _token_registry, token);
+    parg_assert(iter != kh_end(_token_registry), "Unknown token");
+    return kh_value(_token_registry, iter);
+}
+
+parg_token parg_token_from_string(const char* cstring)
+{
+    parg_token token = kh_str_hash_func(cstring);
+    const char** slot = intern_slot(token, cstring);
+    if (slot) {
+        *slot = arena_strdup(cstring);
+    }
     return token;
 }
+
+void parg_token_intern(parg_token token, const char* literal)
+{
+#ifdef PARG_TOKEN_DEBUG
+    parg_verify(token == kh_str_hash_func(literal), "Token hash mismatch",
+        literal);
+#endif
+    const char** slot = intern_slot(token, literal);
+    if (slot) {
+        *slot = literal;
+    }
+}
@@ -1,9 +1,34 @@
 #include <parg.h>
+#include <string.h>
 #include "pargl.h"
 
+// Each program keeps a copy of the last value uploaded to each of its
+// uniforms, so setting a uniform to its current value costs a comparison
+// rather than a GL call.
+static int _issued = 0;
+static int _skipped = 0;
+
+// Returns the location of the uniform if the value differs from its shadow
+// copy, which is then updated, otherwise returns -1.
+GLint parg_uniform_changed(parg_token tok, void const* val, int nbytes)
+{
+    parg_uniform_state* state = parg_shader_uniform_state(tok);
+    if (!state) {
+        return -1;
+    }
+    if (state->nbytes == nbytes && !memcmp(state->shadow, val, nbytes)) {
+        _skipped++;
+        return -1;
+    }
+    memcpy(state->shadow, val, nbytes);
+    state->nbytes = nbytes;
+    _issued++;
+    return state->location;
+}
+
 void parg_uniform1i(parg_token tok, int val)
 {
-    GLint loc = parg_shader_uniform_get(tok);
+    GLint loc = parg_uniform_changed(tok, &val, sizeof(val));
     if (loc > -1) {
         glUniform1i(loc, val);
     }
@@ -11,7 +36,7 @@ void parg_uniform1i(parg_token tok, int val)
 
 void parg_uniform1f(parg_token tok, float val)
 {
-    GLint loc = parg_shader_uniform_get(tok);
+    GLint loc = parg_uniform_changed(tok, &val, sizeof(val));
     if (loc > -1) {
         glUniform1f(loc, val);
     }
@@ -19,7 +44,8 @@ void parg_uniform1f(parg_token tok, float val)
 
 void parg_uniform2f(parg_token tok, float x, float y)
 {
-    GLint loc = parg_shader_uniform_get(tok);
+    float val[2] = {x, y};
+    GLint loc = parg_uniform_changed(tok, val, sizeof(val));
     if (loc > -1) {
         glUniform2f(loc, x, y);
     }
@@ -27,7 +53,7 @@ void parg_uniform2f(parg_token tok, float x, float y)
 
 void parg_uniform3f(parg_token tok, const Vector3* val)
 {
-    GLint loc = parg_shader_uniform_get(tok);
+    GLint loc = parg_uniform_changed(tok, &val->x, sizeof(float) * 3);
     if (loc > -1) {
         glUniform3fv(loc, 1, &val->x);
     }
@@ -35,7 +61,7 @@ void parg_uniform3f(parg_token tok, const Vector3* val)
 
 void parg_uniform4f(parg_token tok, const Vector4* val)
 {
-    GLint loc = parg_shader_uniform_get(tok);
+    GLint loc = parg_uniform_changed(tok, &val->x, sizeof(float) * 4);
     if (loc > -1) {
         glUniform4fv(loc, 1, &val->x);
     }
@@ -43,7 +69,7 @@ void parg_uniform4f(parg_token tok, const Vector4* val)
 
 void parg_uniform_point(parg_token tok, const Point3* val)
 {
-    GLint loc = parg_shader_uniform_get(tok);
+    GLint loc = parg_uniform_changed(tok, &val->x, sizeof(float) * 3);
     if (loc > -1) {
         glUniform3fv(loc, 1, &val->x);
     }
@@ -51,21 +77,29 @@ void parg_uniform_point(parg_token tok, const Point3* val)
 
 void parg_uniform_matrix4f(parg_token tok, const Matrix4* val)
 {
-    GLint loc = parg_shader_uniform_get(tok);
+    GLint loc = parg_uniform_changed(tok, &val->col0.x, sizeof(float) * 16);
     if (loc > -1) {
         glUniformMatrix4fv(loc, 1, 0, &val->col0.x);
     }
 }
 
+// Matrix3 columns may be padded, so they are packed before comparing.
 void parg_uniform_matrix3f(parg_token tok, const Matrix3* val)
 {
-    GLint loc = parg_shader_uniform_get(tok);
-    if (loc == -1) {
-        return;
-    }
     float packed[9];
-    for (int i = 0; i < 9; ++i) {
-        packed[i] = M3GetElem(*val, i / 3, i % 3);
+    memcpy(packed + 0, &val->col0.x, sizeof(float) * 3);
+    memcpy(packed + 3, &val->col1.x, sizeof(float) * 3);
+    memcpy(packed + 6, &val->col2.x, sizeof(float) * 3);
+    GLint loc = parg_uniform_changed(tok, packed, sizeof(packed));
+    if (loc > -1) {
+        glUniformMatrix3fv(loc, 1, 0, packed);
     }
-    glUniformMatrix3fv(loc, 1, 0, &packed[0]);
 }
+
+void parg_uniform_counters(int* issued, int* skipped)
+{
+    *issued = _issued;
+    *skipped = _skipped;
+}
+
+void parg_uniform_reset_counters() { _issued = _skipped = 0; }
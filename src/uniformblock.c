@@ -0,0 +1,301 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+#include "pargl.h"
+#include "khash.h"
+
+// Uniform blocks are declared in .glsl files between "@block NAME" and
+// "@endblock" lines, with one member declaration per line.  Each block has a
+// std140 copy on the CPU that is filled with parg_uniformblock_set.  When
+// the driver supports uniform buffer objects, the copy is uploaded once after
+// it changes and the buffer is bound to every program that declares the
+// block.  Otherwise the members are emitted as ordinary uniforms and copied
+// into each program as it is bound, where the shadow values filter out
+// redundant uploads.
+
+typedef struct {
+    parg_token name;
+    GLenum type;
+    int offset;
+    int nbytes;
+} block_member;
+
+typedef struct {
+    parg_token name;
+    block_member* members;
+    int nmembers;
+    char* storage;
+    int nbytes;
+    GLuint ubo;
+    int dirty;
+} uniform_block;
+
+// Mapping from member tokens to block index and member index.
+KHASH_MAP_INIT_INT(mmap, int)
+
+#define MAX_BLOCKS 16
+#define MEMBER_KEY(block, member) ((block) << 16 | (member))
+
+static uniform_block _blocks[MAX_BLOCKS];
+static int _nblocks = 0;
+static khash_t(mmap)* _member_registry = 0;
+static int _native = -1;
+
+static const struct {
+    const char* name;
+    GLenum type;
+    int nbytes;
+    int alignment;
+} MEMBER_TYPES[] = {
+    {"float", GL_FLOAT, 4, 4},
+    {"int", GL_INT, 4, 4},
+    {"bool", GL_BOOL, 4, 4},
+    {"vec2", GL_FLOAT_VEC2, 8, 8},
+    {"vec3", GL_FLOAT_VEC3, 12, 16},
+    {"vec4", GL_FLOAT_VEC4, 16, 16},
+    {"mat3", GL_FLOAT_MAT3, 48, 16},
+    {"mat4", GL_FLOAT_MAT4, 64, 16},
+};
+
+#define NTYPES (sizeof(MEMBER_TYPES) / sizeof(MEMBER_TYPES[0]))
+
+// Returns true if blocks are backed by uniform buffer objects.
+int parg_uniformblock_native()
+{
+    if (_native < 0) {
+#if EMSCRIPTEN
+        _native = 0;
+#else
+        _native = parg_state_has_extension("GL_ARB_uniform_buffer_object");
+#endif
+    }
+    return _native;
+}
+
+// Text to insert at the top of every shader in a buffer that uses blocks.
+const char* parg_uniformblock_glsl_prefix()
+{
+    return parg_uniformblock_native() ?
+        "#extension GL_ARB_uniform_buffer_object : enable\n" : "";
+}
+
+static int find_type(const char* name)
+{
+    for (int t = 0; t < NTYPES; t++) {
+        if (!strcmp(MEMBER_TYPES[t].name, name)) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+// Registers the block described by the given member lines and returns the
+// GLSL that replaces it.  A block may be declared by several buffers as long
+// as the layouts agree.
+sds parg_uniformblock_declare(sds name, sds const* lines, int nlines)
+{
+    if (!_member_registry) {
+        _member_registry = kh_init(mmap);
+    }
+    parg_token tok = parg_token_from_string(name);
+    int index = 0;
+    while (index < _nblocks && _blocks[index].name != tok) {
+        index++;
+    }
+    parg_verify(index < MAX_BLOCKS, "Too many uniform blocks", name);
+    uniform_block* block = _blocks + index;
+    int existing = index < _nblocks;
+    if (!existing) {
+        block->name = tok;
+        block->members = malloc(sizeof(block_member) * nlines);
+        block->nmembers = 0;
+        block->nbytes = 0;
+        _nblocks++;
+    }
+    sds native = sdscatprintf(sdsempty(), "layout(std140) uniform %s {\n",
+        name);
+    sds fallback = sdsempty();
+    int nmembers = 0;
+    int offset = 0;
+    for (int j = 0; j < nlines; j++) {
+        sds line = sdstrim(sdsdup(lines[j]), "; \t");
+        if (!sdslen(line) || !strncmp(line, "//", 2)) {
+            sdsfree(line);
+            continue;
+        }
+        int nwords;
+        sds* words = sdssplitlen(line, sdslen(line), " \t", 1, &nwords);
+        int t = nwords >= 2 ? find_type(words[nwords - 2]) : -1;
+        parg_verify(t >= 0, "Unsupported block member", line);
+        int alignment = MEMBER_TYPES[t].alignment;
+        offset = (offset + alignment - 1) / alignment * alignment;
+        block_member member = {parg_token_from_string(words[nwords - 1]),
+            MEMBER_TYPES[t].type, offset, MEMBER_TYPES[t].nbytes};
+        offset += member.nbytes;
+        if (existing) {
+            parg_verify(nmembers < block->nmembers &&
+                    block->members[nmembers].name == member.name &&
+                    block->members[nmembers].offset == member.offset,
+                "Mismatched uniform block", name);
+        } else {
+            int ret;
+            khiter_t iter = kh_put(mmap, _member_registry, member.name, &ret);
+            parg_verify(ret, "Duplicate block member", line);
+            kh_value(_member_registry, iter) = MEMBER_KEY(index, nmembers);
+            block->members[nmembers] = member;
+        }
+        nmembers++;
+        native = sdscatprintf(native, "    %s;\n", line);
+        fallback = sdscatprintf(fallback, "uniform %s;\n", line);
+        sdsfreesplitres(words, nwords);
+        sdsfree(line);
+    }
+    if (!existing) {
+        block->nmembers = nmembers;
+        block->nbytes = (offset + 15) / 16 * 16;
+        block->storage = calloc(1, block->nbytes);
+        block->dirty = 1;
+    }
+    parg_verify(nmembers == block->nmembers, "Mismatched uniform block", name);
+    native = sdscat(native, "};\n");
+    if (parg_uniformblock_native()) {
+        sdsfree(fallback);
+        return native;
+    }
+    sdsfree(native);
+    return fallback;
+}
+
+// Copies a value into the block that contains the given member.  Values use
+// the vmath layout, so matrices and vectors can be passed directly.  The
+// unpadded columns of a Matrix3 are spread out to the std140 stride.  The
+// change takes effect at the next parg_shader_bind.
+void parg_uniformblock_set(parg_token member, void const* value)
+{
+    parg_assert(_member_registry, "No uniform blocks");
+    khiter_t iter = kh_get(mmap, _member_registry, member);
+    parg_verify(iter != kh_end(_member_registry), "Unknown block member",
+        parg_token_to_string(member));
+    int key = kh_value(_member_registry, iter);
+    uniform_block* block = _blocks + (key >> 16);
+    block_member const* m = block->members + (key & 0xffff);
+    char* dst = block->storage + m->offset;
+    float padded[12] = {0};
+    if (m->type == GL_FLOAT_MAT3) {
+        for (int c = 0; c < 3; c++) {
+            memcpy(padded + c * 4, (float const*) value + c * 3,
+                sizeof(float) * 3);
+        }
+        value = padded;
+    }
+    if (memcmp(dst, value, m->nbytes)) {
+        memcpy(dst, value, m->nbytes);
+        block->dirty = 1;
+    }
+}
+
+// Fills the conventional camera members of any declared block.
+void parg_uniformblock_zcam()
+{
+    Matrix4 projection, view;
+    parg_zcam_matrices(&projection, &view);
+    Matrix4 mvp = M4Mul(projection, view);
+    Point3 eyepos;
+    parg_zcam_highprec(0, 0, &eyepos);
+    float magnification = parg_zcam_get_magnification();
+    struct {
+        const char* name;
+        void const* value;
+    } const members[] = {
+        {"u_mvp", &mvp},
+        {"u_projection", &projection},
+        {"u_view", &view},
+        {"u_eyepos", &eyepos},
+        {"u_magnification", &magnification},
+    };
+    for (int i = 0; i < sizeof(members) / sizeof(members[0]); i++) {
+        parg_token tok = parg_token_from_string(members[i].name);
+        if (_member_registry &&
+            kh_get(mmap, _member_registry, tok) != kh_end(_member_registry)) {
+            parg_uniformblock_set(tok, members[i].value);
+        }
+    }
+}
+
+// Connects the blocks declared by a newly linked program to their binding
+// points, which are simply the block indices.
+void parg_uniformblock_link(GLuint program)
+{
+#if !EMSCRIPTEN
+    if (!parg_uniformblock_native()) {
+        return;
+    }
+    for (int b = 0; b < _nblocks; b++) {
+        const char* name = parg_token_to_string(_blocks[b].name);
+        GLuint index = glGetUniformBlockIndex(program, name);
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, index, b);
+        }
+    }
+#endif
+}
+
+static void upload_member(block_member const* member, char const* storage)
+{
+    void const* value = storage + member->offset;
+    float packed[9];
+    if (member->type == GL_FLOAT_MAT3) {
+        for (int c = 0; c < 3; c++) {
+            memcpy(packed + c * 3, (float const*) value + c * 4,
+                sizeof(float) * 3);
+        }
+        value = packed;
+    }
+    int nbytes = member->type == GL_FLOAT_MAT3 ? sizeof(packed)
+        : member->nbytes;
+    GLint loc = parg_uniform_changed(member->name, value, nbytes);
+    if (loc < 0) {
+        return;
+    }
+    switch (member->type) {
+    case GL_FLOAT: glUniform1fv(loc, 1, value); break;
+    case GL_INT:
+    case GL_BOOL: glUniform1iv(loc, 1, value); break;
+    case GL_FLOAT_VEC2: glUniform2fv(loc, 1, value); break;
+    case GL_FLOAT_VEC3: glUniform3fv(loc, 1, value); break;
+    case GL_FLOAT_VEC4: glUniform4fv(loc, 1, value); break;
+    case GL_FLOAT_MAT3: glUniformMatrix3fv(loc, 1, 0, value); break;
+    case GL_FLOAT_MAT4: glUniformMatrix4fv(loc, 1, 0, value); break;
+    }
+}
+
+// Called whenever a program is bound.  Buffers are uploaded only if their
+// contents changed, while the fallback path visits every member.
+void parg_uniformblock_apply()
+{
+    for (int b = 0; b < _nblocks; b++) {
+        uniform_block* block = _blocks + b;
+        if (!parg_uniformblock_native()) {
+            for (int m = 0; m < block->nmembers; m++) {
+                upload_member(block->members + m, block->storage);
+            }
+            continue;
+        }
+#if !EMSCRIPTEN
+        if (!block->ubo) {
+            glGenBuffers(1, &block->ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, block->ubo);
+            glBufferData(GL_UNIFORM_BUFFER, block->nbytes, 0,
+                GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, b, block->ubo);
+        }
+        if (block->dirty) {
+            glBindBuffer(GL_UNIFORM_BUFFER, block->ubo);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, block->nbytes,
+                block->storage);
+            block->dirty = 0;
+        }
+#endif
+    }
+}
@@ -1,10 +1,76 @@
 #include <parg.h>
+#include <stdlib.h>
+#include <string.h>
 #include "pargl.h"
 #include "internal.h"
 
+// A layout records the attribute streams and index buffer of a draw so that
+// they can be applied with one call.  Where vertex array objects exist, the
+// first bind captures the calls in a VAO and later binds are a single
+// glBindVertexArray.  Elsewhere the recorded calls are replayed, after the
+// arrays and divisors left by the previously replayed layout are reset, so
+// both paths draw with the same state.  Layouts refer to their buffers
+// without owning them.  Each mesh keeps the layouts
+// built from it, and rebuilds one when the mesh has been given new buffers.
+
+#define MAX_LAYOUT_ATTRIBS 16
+
+typedef struct {
+    parg_token attr;
+    parg_buffer* buffer;
+    int ncomps;
+    parg_data_type type;
+    int normalized;
+    int stride;
+    int offset;
+    int divisor;
+} layout_attrib;
+
+struct parg_varray_layout_s {
+    layout_attrib attribs[MAX_LAYOUT_ATTRIBS];
+    int nattribs;
+    parg_buffer* indices;
+    GLuint vao;
+    int dirty;
+    parg_token tokens[PARG_MESH_NATTRIBS];
+    uint64_t signature;
+    parg_varray_layout* next;
+};
+
+static int _native = -1;
+
+// Attribute slots enabled, and given a divisor, by the last replayed layout.
+static uint32_t _replayed_arrays;
+static uint32_t _replayed_divisors;
+
+static int layouts_native()
+{
+    if (_native < 0) {
+#if EMSCRIPTEN
+        _native = 0;
+#else
+        GLint major = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        _native = major >= 3 ||
+            parg_state_has_extension("GL_ARB_vertex_array_object");
+#endif
+    }
+    return _native;
+}
+
+// Must be called before changing vertex array state outside of a layout,
+// since a layout's VAO may still be bound.
+void parg_varray_unbind_layout()
+{
+    if (_native > 0) {
+        parg_state_bind_vertex_array(0);
+    }
+}
+
 void parg_varray_enable(parg_buffer* buf, parg_token attr, int ncomps,
     parg_data_type type, int stride, int offset)
 {
+    parg_varray_unbind_layout();
     parg_buffer_gpu_bind(buf);
     GLint slot = parg_shader_attrib_get(attr);
     glEnableVertexAttribArray(slot);
@@ -13,16 +79,264 @@ void parg_varray_enable(parg_buffer* buf, parg_token attr, int ncomps,
     glVertexAttribPointer(slot, ncomps, type, GL_FALSE, stride, ptr);
 }
 
-void parg_varray_bind(parg_buffer* buf) { parg_buffer_gpu_bind(buf); }
+void parg_varray_bind(parg_buffer* buf)
+{
+    parg_varray_unbind_layout();
+    parg_buffer_gpu_bind(buf);
+}
 
 void parg_varray_disable(parg_token attr)
 {
+    parg_varray_unbind_layout();
     GLint slot = parg_shader_attrib_get(attr);
     glDisableVertexAttribArray(slot);
 }
 
 void parg_varray_instances(parg_token attr, int divisor)
 {
+    parg_varray_unbind_layout();
     GLint slot = parg_shader_attrib_get(attr);
     pargVertexAttribDivisor(slot, divisor);
 }
+
+static void enable_attrib(parg_token attr, parg_vertex_attrib const* attrib,
+    int stride)
+{
+    GLint slot = parg_shader_attrib_get(attr);
+    glEnableVertexAttribArray(slot);
+    long offset64 = attrib->offset;
+    const GLvoid* ptr = (const GLvoid*) offset64;
+    glVertexAttribPointer(slot, attrib->ncomps, attrib->type,
+        attrib->normalized ? GL_TRUE : GL_FALSE, stride, ptr);
+}
+
+// Enables every attribute that the mesh has and that has a non-zero token,
+// and binds the index buffer if one exists.  Interleaved meshes require only
+// a single buffer bind.
+void parg_varray_enable_mesh(parg_mesh* mesh, parg_token coord, parg_token uv,
+    parg_token normal, parg_token tangent)
+{
+    parg_token tokens[PARG_MESH_NATTRIBS] = {coord, uv, normal, tangent};
+    parg_varray_unbind_layout();
+    if (mesh->vertices) {
+        parg_buffer_gpu_bind(mesh->vertices);
+        for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+            if (tokens[a] && mesh->layout[a].ncomps) {
+                enable_attrib(tokens[a], &mesh->layout[a], mesh->stride);
+            }
+        }
+    } else {
+        parg_buffer* buffers[PARG_MESH_NATTRIBS] = {
+            mesh->coords, mesh->uvs, mesh->normals, mesh->tangents};
+        for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+            if (tokens[a] && buffers[a]) {
+                parg_buffer_gpu_bind(buffers[a]);
+                enable_attrib(tokens[a], &mesh->layout[a], 0);
+            }
+        }
+    }
+    if (mesh->indices) {
+        parg_buffer_gpu_bind(mesh->indices);
+    }
+}
+
+parg_varray_layout* parg_varray_layout_create()
+{
+    return calloc(1, sizeof(struct parg_varray_layout_s));
+}
+
+void parg_varray_layout_free(parg_varray_layout* layout)
+{
+    if (!layout) {
+        return;
+    }
+#if !EMSCRIPTEN
+    if (layout->vao) {
+        parg_state_forget_vertex_array(layout->vao);
+        glDeleteVertexArrays(1, &layout->vao);
+    }
+#endif
+    free(layout);
+}
+
+static layout_attrib* find_attrib(parg_varray_layout* layout, parg_token attr)
+{
+    layout->dirty = 1;
+    for (int i = 0; i < layout->nattribs; i++) {
+        if (layout->attribs[i].attr == attr) {
+            return layout->attribs + i;
+        }
+    }
+    parg_assert(layout->nattribs < MAX_LAYOUT_ATTRIBS, "Too many attributes");
+    layout_attrib* attrib = layout->attribs + layout->nattribs++;
+    *attrib = (layout_attrib){attr};
+    return attrib;
+}
+
+void parg_varray_layout_enable(parg_varray_layout* layout, parg_buffer* buf,
+    parg_token attr, int ncomps, parg_data_type type, int stride, int offset)
+{
+    layout_attrib* attrib = find_attrib(layout, attr);
+    attrib->buffer = buf;
+    attrib->ncomps = ncomps;
+    attrib->type = type;
+    attrib->normalized = 0;
+    attrib->stride = stride;
+    attrib->offset = offset;
+}
+
+// The divisor is stored plus one, so attributes without one leave the
+// current divisor alone, as parg_varray_enable does.
+void parg_varray_layout_instances(
+    parg_varray_layout* layout, parg_token attr, int divisor)
+{
+    find_attrib(layout, attr)->divisor = divisor + 1;
+}
+
+void parg_varray_layout_index(parg_varray_layout* layout, parg_buffer* buf)
+{
+    layout->indices = buf;
+    layout->dirty = 1;
+}
+
+static void apply_layout(parg_varray_layout const* layout)
+{
+    for (int i = 0; i < layout->nattribs; i++) {
+        layout_attrib const* attrib = layout->attribs + i;
+        GLint slot = parg_shader_attrib_get(attrib->attr);
+        if (attrib->buffer) {
+            parg_buffer_gpu_bind(attrib->buffer);
+            glEnableVertexAttribArray(slot);
+            long offset64 = attrib->offset;
+            const GLvoid* ptr = (const GLvoid*) offset64;
+            glVertexAttribPointer(slot, attrib->ncomps, attrib->type,
+                attrib->normalized ? GL_TRUE : GL_FALSE, attrib->stride, ptr);
+        }
+        if (attrib->divisor) {
+            pargVertexAttribDivisor(slot, attrib->divisor - 1);
+        }
+    }
+    if (layout->indices) {
+        parg_buffer_gpu_bind(layout->indices);
+    }
+}
+
+static void replay_layout(parg_varray_layout const* layout)
+{
+    uint32_t arrays = 0, divisors = 0;
+    for (int i = 0; i < layout->nattribs; i++) {
+        layout_attrib const* attrib = layout->attribs + i;
+        GLuint slot = parg_shader_attrib_get(attrib->attr);
+        parg_assert(slot < 32, "Attribute slot out of range");
+        if (attrib->buffer) {
+            arrays |= 1u << slot;
+        }
+        if (attrib->divisor > 1) {
+            divisors |= 1u << slot;
+        }
+    }
+    uint32_t stale = _replayed_arrays & ~arrays;
+    for (GLuint slot = 0; stale; slot++, stale >>= 1) {
+        if (stale & 1) {
+            glDisableVertexAttribArray(slot);
+        }
+    }
+    stale = _replayed_divisors & ~divisors;
+    for (GLuint slot = 0; stale; slot++, stale >>= 1) {
+        if (stale & 1) {
+            pargVertexAttribDivisor(slot, 0);
+        }
+    }
+    apply_layout(layout);
+    _replayed_arrays = arrays;
+    _replayed_divisors = divisors;
+}
+
+// A changed layout gets a fresh VAO rather than patching the old one, which
+// could have attributes enabled that are no longer in the layout.
+void parg_varray_layout_bind(parg_varray_layout* layout)
+{
+    if (!layouts_native()) {
+        replay_layout(layout);
+        return;
+    }
+#if !EMSCRIPTEN
+    if (layout->vao && !layout->dirty) {
+        parg_state_bind_vertex_array(layout->vao);
+        return;
+    }
+    if (layout->vao) {
+        parg_state_forget_vertex_array(layout->vao);
+        glDeleteVertexArrays(1, &layout->vao);
+    }
+    glGenVertexArrays(1, &layout->vao);
+    parg_state_bind_vertex_array(layout->vao);
+    apply_layout(layout);
+    layout->dirty = 0;
+#endif
+}
+
+static uint64_t mesh_signature(parg_mesh const* mesh)
+{
+    parg_buffer* buffers[] = {mesh->coords, mesh->uvs, mesh->normals,
+        mesh->tangents, mesh->indices, mesh->vertices};
+    uint64_t hash = PARG_HASH_SEED;
+    for (int i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        uint32_t serial = buffers[i] ? parg_buffer_serial(buffers[i]) : 0;
+        hash = parg_hash_bytes(&serial, sizeof(serial), hash);
+    }
+    hash = parg_hash_bytes(mesh->layout, sizeof(mesh->layout), hash);
+    return parg_hash_bytes(&mesh->stride, sizeof(mesh->stride), hash);
+}
+
+static void fill_mesh_layout(parg_varray_layout* layout, parg_mesh* mesh)
+{
+    parg_buffer* buffers[PARG_MESH_NATTRIBS] = {
+        mesh->coords, mesh->uvs, mesh->normals, mesh->tangents};
+    layout->nattribs = 0;
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        parg_vertex_attrib const* src = mesh->layout + a;
+        parg_buffer* buf = mesh->vertices ? mesh->vertices : buffers[a];
+        if (!layout->tokens[a] || !buf ||
+            (mesh->vertices && !src->ncomps)) {
+            continue;
+        }
+        layout_attrib* attrib = find_attrib(layout, layout->tokens[a]);
+        *attrib = (layout_attrib){layout->tokens[a], buf, src->ncomps,
+            src->type, src->normalized, mesh->vertices ? mesh->stride : 0,
+            src->offset};
+    }
+    parg_varray_layout_index(layout, mesh->indices);
+    layout->signature = mesh_signature(mesh);
+}
+
+// Returns the layout equivalent to parg_varray_enable_mesh with the same
+// arguments.  The mesh owns the layout.
+parg_varray_layout* parg_varray_mesh_layout(parg_mesh* mesh, parg_token coord,
+    parg_token uv, parg_token normal, parg_token tangent)
+{
+    parg_token tokens[PARG_MESH_NATTRIBS] = {coord, uv, normal, tangent};
+    parg_varray_layout* layout = mesh->varrays;
+    while (layout && memcmp(layout->tokens, tokens, sizeof(tokens))) {
+        layout = layout->next;
+    }
+    if (!layout) {
+        layout = parg_varray_layout_create();
+        memcpy(layout->tokens, tokens, sizeof(tokens));
+        layout->next = mesh->varrays;
+        mesh->varrays = layout;
+        fill_mesh_layout(layout, mesh);
+    } else if (layout->signature != mesh_signature(mesh)) {
+        fill_mesh_layout(layout, mesh);
+    }
+    return layout;
+}
+
+void parg_varray_free_mesh_layouts(parg_mesh* mesh)
+{
+    while (mesh->varrays) {
+        parg_varray_layout* next = mesh->varrays->next;
+        parg_varray_layout_free(mesh->varrays);
+        mesh->varrays = next;
+    }
+}
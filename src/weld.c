@@ -0,0 +1,201 @@
+#include <parg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "internal.h"
+
+// Vertices are bucketed into a hash grid whose cells are several times wider
+// than epsilon, so most candidates for a merge lie in the vertex's own cell
+// and only vertices near a cell boundary need to visit a neighbor.  Only the
+// first vertex of each cluster is inserted into the grid, and later vertices
+// are merged into it if all selected attributes agree to within epsilon per
+// component.  With a zero epsilon the grid degenerates into an
+// exact-match hash on the position bits.
+
+typedef struct {
+    int32_t cell[3];
+    int head;
+} weld_slot;
+
+typedef struct {
+    weld_slot* slots;
+    uint32_t mask;
+    int* next;
+} weld_grid;
+
+static uint32_t hash_cell(int32_t const* cell)
+{
+    return (uint32_t) cell[0] * 73856093u ^ (uint32_t) cell[1] * 19349663u ^
+        (uint32_t) cell[2] * 83492791u;
+}
+
+// Returns the slot for the given cell, which is empty if head is negative.
+static weld_slot* find_slot(weld_grid* grid, int32_t const* cell)
+{
+    uint32_t h = hash_cell(cell) & grid->mask;
+    while (1) {
+        weld_slot* slot = grid->slots + h;
+        if (slot->head < 0 ||
+            !memcmp(slot->cell, cell, sizeof(slot->cell))) {
+            return slot;
+        }
+        h = (h + 1) & grid->mask;
+    }
+}
+
+#define CELL_SCALE 4
+#define CELL_LIMIT 1073741824.0f
+
+// Converts a coordinate in cell units to a cell index.  Coordinates beyond
+// 2^30 cells share the boundary cell, which only costs extra comparisons
+// since vertices_match checks the actual positions.
+static int32_t cell_index(float x)
+{
+    return (int32_t) floorf(fminf(fmaxf(x, -CELL_LIMIT), CELL_LIMIT));
+}
+
+// Finds the cell containing p, and the range of cells touched by a box of
+// radius epsilon around p.
+static void find_cells(float const* p, float epsilon, int32_t* cell,
+    int32_t* lo, int32_t* hi)
+{
+    for (int c = 0; c < 3; c++) {
+        if (epsilon > 0) {
+            float invcell = 1.0f / (epsilon * CELL_SCALE);
+            cell[c] = cell_index(p[c] * invcell);
+            lo[c] = cell_index((p[c] - epsilon) * invcell);
+            hi[c] = cell_index((p[c] + epsilon) * invcell);
+        } else {
+            float f = p[c] + 0.0f;
+            memcpy(cell + c, &f, sizeof(f));
+            lo[c] = hi[c] = cell[c];
+        }
+    }
+}
+
+typedef struct {
+    float const* data;
+    int ncomps;
+} weld_attrib;
+
+static int vertices_match(weld_attrib const* attribs, int nattribs, int a,
+    int b, float epsilon)
+{
+    for (int i = 0; i < nattribs; i++) {
+        int n = attribs[i].ncomps;
+        float const* pa = attribs[i].data + a * n;
+        float const* pb = attribs[i].data + b * n;
+        for (int c = 0; c < n; c++) {
+            if (fabsf(pa[c] - pb[c]) > epsilon) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static float const* lock_float_attrib(
+    parg_mesh* mesh, parg_buffer* buf, int attrib)
+{
+    parg_assert(!parg_buffer_gpu_check(buf), "CPU mesh required");
+    parg_assert(mesh->layout[attrib].type == PARG_FLOAT,
+        "Welding requires float attributes");
+    return parg_buffer_lock(buf, PARG_READ);
+}
+
+float parg_mesh_weld(parg_mesh* mesh, float epsilon, int attribute_mask)
+{
+    parg_assert(mesh->coords, "Non-interleaved mesh required");
+    parg_assert(mesh->layout[PARG_MESH_COORD].ncomps == 3,
+        "Welding requires float3 coordinates");
+    int nverts = parg_mesh_nverts(mesh);
+    if (nverts == 0) {
+        return 1;
+    }
+    parg_buffer* buffers[PARG_MESH_NATTRIBS] = {
+        mesh->coords, mesh->uvs, mesh->normals, mesh->tangents};
+    int masks[PARG_MESH_NATTRIBS] = {
+        0, PARG_WELD_UV, PARG_WELD_NORMAL, PARG_WELD_TANGENT};
+
+    // Positions are always compared, since they drive the grid lookup.
+    int compared[PARG_MESH_NATTRIBS];
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        compared[a] = buffers[a] &&
+            (a == PARG_MESH_COORD || (attribute_mask & masks[a]));
+    }
+    weld_attrib attribs[PARG_MESH_NATTRIBS];
+    int nattribs = 0;
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        if (compared[a]) {
+            attribs[nattribs].data = lock_float_attrib(mesh, buffers[a], a);
+            attribs[nattribs++].ncomps = mesh->layout[a].ncomps;
+        }
+    }
+
+    weld_grid grid;
+    uint32_t nslots = 1;
+    while (nslots < (uint32_t) nverts * 2) {
+        nslots <<= 1;
+    }
+    grid.mask = nslots - 1;
+    grid.slots = malloc(sizeof(weld_slot) * nslots);
+    for (uint32_t s = 0; s < nslots; s++) {
+        grid.slots[s].head = -1;
+    }
+    grid.next = malloc(sizeof(int) * nverts);
+    int* target = malloc(sizeof(int) * nverts);
+    int* remap = malloc(sizeof(int) * nverts);
+    int newcount = 0;
+    for (int v = 0; v < nverts; v++) {
+        float const* p = attribs[0].data + v * 3;
+        int32_t cell[3], lo[3], hi[3];
+        find_cells(p, epsilon, cell, lo, hi);
+        target[v] = -1;
+        for (int z = lo[2]; z <= hi[2] && target[v] < 0; z++) {
+            for (int y = lo[1]; y <= hi[1] && target[v] < 0; y++) {
+                for (int x = lo[0]; x <= hi[0] && target[v] < 0; x++) {
+                    int32_t neighbor[3] = {x, y, z};
+                    weld_slot* slot = find_slot(&grid, neighbor);
+                    for (int r = slot->head; r >= 0; r = grid.next[r]) {
+                        if (vertices_match(
+                                attribs, nattribs, v, r, epsilon)) {
+                            target[v] = remap[r];
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        remap[v] = -1;
+        if (target[v] < 0) {
+            weld_slot* slot = find_slot(&grid, cell);
+            memcpy(slot->cell, cell, sizeof(cell));
+            grid.next[v] = slot->head;
+            slot->head = v;
+            remap[v] = target[v] = newcount++;
+        }
+    }
+    for (int a = 0; a < PARG_MESH_NATTRIBS; a++) {
+        if (compared[a]) {
+            parg_buffer_unlock(buffers[a]);
+        }
+    }
+    free(grid.slots);
+    free(grid.next);
+
+    // Merged vertices take the attributes of the first vertex in their
+    // cluster.  Narrow the indices to 16 bits when the result allows it.
+    uint32_t* indices = parg_mesh_read_indices(mesh);
+    for (int i = 0; i < mesh->ntriangles * 3; i++) {
+        indices[i] = target[indices[i]];
+    }
+    parg_mesh_remap_vertices(mesh, nverts, remap, newcount);
+    if (newcount <= 0x10000) {
+        mesh->indextype = PARG_USHORT;
+    }
+    parg_mesh_write_indices(mesh, indices, mesh->ntriangles);
+    free(indices);
+    free(target);
+    free(remap);
+    return (float) newcount / nverts;
+}
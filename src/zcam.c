@@ -27,6 +27,16 @@ DPoint3 parg_zcam_to_world(float winx, float winy)
     return worldspace;
 }
 
+// The ray starts at the camera and passes through the point on the z=0 plane
+// beneath the given window coordinate, which is useful for picking.
+void parg_zcam_to_ray(float winx, float winy, Point3* origin, Vector3* dir)
+{
+    DPoint3 target = parg_zcam_to_world(winx, winy);
+    DVector3 delta = DV3Normalize(DP3Sub(target, _camerapos));
+    *origin = (Point3){_camerapos.x, _camerapos.y, _camerapos.z};
+    *dir = (Vector3){delta.x, delta.y, delta.z};
+}
+
 void parg_zcam_get_viewport(float* lbrt)
 {
     double vpheight = 2 * tan(_fovy / 2) * _camerapos.z;